@@ -0,0 +1,99 @@
+#include "affinity2048.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#define AFFINITY_LINUX 1
+#endif
+
+namespace {
+
+std::mutex s_cpuMutex;
+std::vector<int> s_cpus;
+std::atomic<int> s_nextSlot{0};
+thread_local bool t_pinned = false;
+
+} // namespace
+
+std::vector<int> parseCpuList(const std::string& list)
+{
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string part;
+    while (std::getline(ss, part, ',')) {
+        int first = 0, last = 0;
+        char dash = 0;
+        std::stringstream ps(part);
+        if (!(ps >> first)) continue;
+        last = first;
+        if (ps >> dash && (dash != '-' || !(ps >> last))) continue;
+        for (int c = first; c <= last && c >= 0; ++c) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+std::vector<int> numaNodeCpus(int node)
+{
+    std::ifstream ifs("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string list;
+    if (!std::getline(ifs, list)) return {};
+    return parseCpuList(list);
+}
+
+void setSimulationCpus(const std::vector<int>& cpus)
+{
+    std::scoped_lock lock(s_cpuMutex);
+    s_cpus = cpus;
+}
+
+std::vector<int> simulationCpus()
+{
+    std::scoped_lock lock(s_cpuMutex);
+    return s_cpus;
+}
+
+bool pinSimulationThread(int slot)
+{
+    int cpu = -1;
+    {
+        std::scoped_lock lock(s_cpuMutex);
+        if (s_cpus.empty()) return false;
+        cpu = s_cpus[std::size_t(slot < 0 ? -slot : slot) % s_cpus.size()];
+    }
+
+#ifdef AFFINITY_LINUX
+    if (cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    t_pinned = pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    return t_pinned;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+bool pinSimulationThread()
+{
+    return t_pinned || pinSimulationThread(s_nextSlot.fetch_add(1));
+}
+
+bool configureSimulationCpusFromEnvironment()
+{
+    std::vector<int> cpus;
+    if (const char* list = std::getenv("GAME2048_CPUS")) {
+        cpus = parseCpuList(list);
+    } else if (const char* node = std::getenv("GAME2048_NUMA_NODE")) {
+        cpus = numaNodeCpus(std::atoi(node));
+    }
+    if (cpus.empty()) return false;
+    setSimulationCpus(cpus);
+    return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Placement of simulation threads (fitness games and search tasks).
+//
+// Threads that call pinSimulationThread() are spread round-robin over the
+// configured CPUs. Under Linux's default first-touch policy everything
+// they allocate afterwards (stacks, games, search scratch) then comes from
+// the NUMA node they run on. Where affinity is unsupported, or when no CPUs
+// are configured, pinning does nothing.
+
+// "0-3,8,10-11", the format of /sys cpulist files and taskset.
+std::vector<int> parseCpuList(const std::string& list);
+
+// CPUs of a NUMA node; empty if the node does not exist.
+std::vector<int> numaNodeCpus(int node);
+
+void setSimulationCpus(const std::vector<int>& cpus);
+std::vector<int> simulationCpus();
+
+// Pins the calling thread to entry slot % count of the configured CPUs.
+// False if none are configured or the OS refused.
+bool pinSimulationThread(int slot);
+
+// Pins the calling thread to the next slot of a process-wide counter, so
+// threads started by unrelated pools still spread over every CPU. A thread
+// that is already pinned keeps its CPU.
+bool pinSimulationThread();
+
+// Applies GAME2048_CPUS (a CPU list) or, failing that, GAME2048_NUMA_NODE.
+// False if neither is set to something usable.
+bool configureSimulationCpusFromEnvironment();
@@ -1,6 +1,16 @@
 #include "ai2048.h"
+#include "affinity2048.h"
+#include "batcheval2048.h"
+#include "gamearchive2048.h"
+#include "genometable2048.h"
+#include "search2048.h"
+#include "trace2048.h"
 #include <cmath>
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <utility>
 #include <random>
 #include <future>
 #include <mutex>
@@ -8,118 +18,83 @@
 #include <sstream>
 #include <thread>
 
-static int countEmpty(const Game2048& g) {
-    int n = g.size();
-    int cnt = 0;
-    for (int r = 0; r < n; ++r)
-        for (int c = 0; c < n; ++c)
-            if (g.at(r, c) == 0) ++cnt;
-    return cnt;
-}
-
-static bool maxInCorner(const Game2048& g) {
-    int n = g.size();
-    int maxVal = 0;
-    for (int r = 0; r < n; ++r)
-        for (int c = 0; c < n; ++c)
-            maxVal = std::max(maxVal, g.at(r, c));
-
-    return
-        g.at(0, 0)       == maxVal ||
-        g.at(0, n-1)     == maxVal ||
-        g.at(n-1, 0)     == maxVal ||
-        g.at(n-1, n-1)   == maxVal;
-}
-
-static double monotonicityScore(const Game2048& g) {
-    int n = g.size();
-    double score = 0.0;
-
-    for (int r = 0; r < n; ++r) {
-        for (int c = 0; c + 1 < n; ++c) {
-            int a = g.at(r, c);
-            int b = g.at(r, c + 1);
-            if (a != 0 && b != 0) {
-                if (a >= b) score += 1.0;
-                else        score -= 1.0;
-            }
-        }
-    }
-
-    for (int c = 0; c < n; ++c) {
-        for (int r = 0; r + 1 < n; ++r) {
-            int a = g.at(r, c);
-            int b = g.at(r + 1, c);
-            if (a != 0 && b != 0) {
-                if (a >= b) score += 1.0;
-                else        score -= 1.0;
-            }
-        }
-    }
-
-    return score;
-}
-
-static double smoothnessScore(const Game2048& g) {
-    int n = g.size();
-    double penalty = 0.0;
-
-    auto logVal = [](int v) {
-        return (v > 0) ? std::log2((double)v) : 0.0;
-    };
-
+// One pass over the board feeding every feature enabled in Mask; disabled
+// features are not even instantiated into the loop.
+template <unsigned Mask>
+static double evaluateFused(const Game2048& g, const Weights& w)
+{
+#define AI2048_FEATURE_ON(name) ((Mask >> int(FeatureId::name)) & 1u)
+#define AI2048_DECLARE(name, F, def, lo, hi, step) F name;
+#define AI2048_CELL(name, F, def, lo, hi, step) \
+    if constexpr (AI2048_FEATURE_ON(name)) name.cell(v);
+#define AI2048_PAIR(name, F, def, lo, hi, step) \
+    if constexpr (AI2048_FEATURE_ON(name)) name.pair(a, b);
+#define AI2048_SCORE(name, F, def, lo, hi, step) \
+    if constexpr (AI2048_FEATURE_ON(name)) score += w.name * name.value(g);
+
+    AI2048_FEATURES(AI2048_DECLARE)
+
+    const int n = g.size();
     for (int r = 0; r < n; ++r) {
         for (int c = 0; c < n; ++c) {
-            int v = g.at(r, c);
-            if (v == 0) continue;
-
+            const int v = g.at(r, c);
+            AI2048_FEATURES(AI2048_CELL)
             if (c + 1 < n) {
-                int v2 = g.at(r, c + 1);
-                if (v2 != 0) penalty += std::abs(logVal(v) - logVal(v2));
+                const int a = v, b = g.at(r, c + 1);
+                AI2048_FEATURES(AI2048_PAIR)
             }
             if (r + 1 < n) {
-                int v2 = g.at(r + 1, c);
-                if (v2 != 0) penalty += std::abs(logVal(v) - logVal(v2));
+                const int a = v, b = g.at(r + 1, c);
+                AI2048_FEATURES(AI2048_PAIR)
             }
         }
     }
 
-    return -penalty;
+    double score = 0.0;
+    AI2048_FEATURES(AI2048_SCORE)
+    return score;
+
+#undef AI2048_SCORE
+#undef AI2048_PAIR
+#undef AI2048_CELL
+#undef AI2048_DECLARE
+#undef AI2048_FEATURE_ON
 }
 
-static int mergePotential(const Game2048& g) {
-    int n = g.size();
-    int cnt = 0;
+using FusedEvaluator = double (*)(const Game2048&, const Weights&);
 
-    for (int r = 0; r < n; ++r) {
-        for (int c = 0; c + 1 < n; ++c) {
-            if (g.at(r,c) != 0 && g.at(r,c) == g.at(r,c+1)) ++cnt;
-        }
-    }
-    for (int c = 0; c < n; ++c) {
-        for (int r = 0; r + 1 < n; ++r) {
-            if (g.at(r,c) != 0 && g.at(r,c) == g.at(r+1,c)) ++cnt;
-        }
-    }
-    return cnt;
+// One instantiation per subset of features, picked by which weights are
+// non-zero.
+static_assert(FeatureCount <= 8, "fused evaluator table grows as 2^FeatureCount");
+
+template <std::size_t... Masks>
+static constexpr std::array<FusedEvaluator, sizeof...(Masks)>
+makeFusedTable(std::index_sequence<Masks...>)
+{
+    return {{ &evaluateFused<unsigned(Masks)>... }};
 }
 
+static constexpr auto fusedEvaluators =
+    makeFusedTable(std::make_index_sequence<std::size_t(1) << FeatureCount>{});
+
 double evaluateBoard(const Game2048& game, const Weights& w)
 {
-    int empty = countEmpty(game);
-    bool corner = maxInCorner(game);
-    double mono = monotonicityScore(game);
-    double smooth = smoothnessScore(game);
-    int merges = mergePotential(game);
+    TRACE_SCOPE("evaluateBoard");
+    unsigned mask = 0;
+    for (int i = 0; i < FeatureCount; ++i)
+        if (w[i] != 0.0) mask |= 1u << i;
 
-    double score = 0.0;
-    score += w.wEmpty     * empty;
-    score += w.wMonotonic * mono;
-    score += w.wSmooth    * smooth;
-    score += w.wMerge     * merges;
-    score += w.wCornerMax * (corner ? 1.0 : -1.0);
+    return fusedEvaluators[mask](game, w);
+}
 
-    return score;
+int searchDepthOf(const Weights& w)
+{
+    return std::clamp(int(std::lround(w.searchDepth)), 1, MaxGeneSearchDepth);
+}
+
+double searchCutoffOf(const Weights& w)
+{
+    return std::max(0.0, w.searchCutoff);
 }
 
 static bool tryMove(Game2048& g, Direction dir) {
@@ -134,6 +109,7 @@ static bool tryMove(Game2048& g, Direction dir) {
 
 Direction chooseMove(const Game2048& game, const Weights& w)
 {
+    TRACE_SCOPE("chooseMove");
     Direction dirs[] = {
         Direction::Left,
         Direction::Right,
@@ -141,8 +117,14 @@ Direction chooseMove(const Game2048& game, const Weights& w)
         Direction::Down
     };
 
-    double bestScore = -1e100;
-    Direction bestDir = Direction::Left;
+    // Afterstates are packed and scored together whenever they fit a Board64;
+    // one move can at most double the largest tile.
+    const bool batched = game.size() <= 4 && game.maxTile() < 32768;
+
+    Direction moved[4];
+    Board64   packed[4];
+    double    scores[4];
+    int count = 0;
 
     for (Direction d : dirs) {
         Game2048 tmp = game;
@@ -150,23 +132,66 @@ Direction chooseMove(const Game2048& game, const Weights& w)
             continue;
         }
 
-        double s = evaluateBoard(tmp, w);
-        if (s > bestScore) {
-            bestScore = s;
-            bestDir = d;
+        moved[count] = d;
+        if (batched) {
+            packBoard(tmp, packed[count]);
+        } else {
+            scores[count] = evaluateBoard(tmp, w);
+        }
+        ++count;
+    }
+
+    if (batched) {
+        evaluateBoards(packed, count, game.size(), w, scores);
+    }
+
+    double bestScore = -1e100;
+    Direction bestDir = Direction::Left;
+
+    for (int i = 0; i < count; ++i) {
+        if (scores[i] > bestScore) {
+            bestScore = scores[i];
+            bestDir = moved[i];
         }
     }
 
     return bestDir;
 }
 
-double playOneGame(const Weights& w, int maxMoves, int* outMoves)
+static std::atomic<GameRecorder*> s_recorder{nullptr};
+
+void setGameRecorder(GameRecorder* recorder)
+{
+    s_recorder = recorder;
+}
+
+static std::uint8_t exponentOf(int value)
+{
+    std::uint8_t e = 0;
+    while ((1 << e) < value) ++e;
+    return e;
+}
+
+static double playGame(Game2048& g, const Weights& w, int maxMoves, int* outMoves,
+                       const std::uint32_t* seed = nullptr)
 {
-    Game2048 g;
     int moves = 0;
 
+    GameRecorder* recorder = s_recorder;
+    GameRecord record;
+
+    // Players whose genes ask for depth search run it to a fixed depth, so
+    // seeded games stay reproducible; one cache serves the whole game.
+    const int depth = searchDepthOf(w);
+    EvalCache cache;
+    SearchOptions opt;
+    opt.maxDepth       = depth;
+    opt.deadlineMs     = 0.0;
+    opt.minProbability = searchCutoffOf(w);
+    opt.cache          = &cache;
+
     while (!g.isGameOver() && moves < maxMoves) {
-        Direction d = chooseMove(g, w);
+        Direction d = (depth > 1) ? searchMove(g, w, opt) : chooseMove(g, w);
 
         bool moved = false;
         switch (d) {
@@ -181,6 +206,27 @@ double playOneGame(const Weights& w, int maxMoves, int* outMoves)
         }
 
         ++moves;
+
+        if (recorder) {
+            MoveSample m;
+            m.score       = std::uint32_t(g.score());
+            m.direction   = std::uint8_t(d);
+            m.emptyCells  = std::uint8_t(g.emptyCount());
+            m.maxExponent = exponentOf(g.maxTile());
+            record.moves.push_back(m);
+        }
+    }
+
+    if (recorder) {
+        record.weightsHash = hashWeights(w);
+        record.generation  = std::uint32_t(recorder->generation());
+        record.seed        = seed ? *seed : 0;
+        record.seeded      = seed != nullptr;
+        record.gameOver    = g.isGameOver();
+        record.size        = g.size();
+        record.score       = std::uint32_t(g.score());
+        record.maxExponent = exponentOf(g.maxTile());
+        recorder->record(record);
     }
 
     if (outMoves) {
@@ -190,13 +236,34 @@ double playOneGame(const Weights& w, int maxMoves, int* outMoves)
     return static_cast<double>(g.score());
 }
 
-double evaluateFitness(const Weights& w, int games, int maxMoves,
+double playOneGame(const Weights& w, int maxMoves, int* outMoves)
+{
+    TRACE_SCOPE("playOneGame");
+    Game2048 g;
+    return playGame(g, w, maxMoves, outMoves);
+}
+
+double playSeededGame(const Weights& w, std::uint32_t seed, int maxMoves, int* outMoves)
+{
+    TRACE_SCOPE("playSeededGame");
+    Game2048 g;
+    g.reseed(seed);
+    return playGame(g, w, maxMoves, outMoves, &seed);
+}
+
+// Shared by the seeded and unseeded variants; seedBegin == nullptr plays
+// freshly seeded games.
+static double runGames(const Weights& w, const std::uint32_t* seedBegin,
+                       int games, int maxMoves,
                        double& outBestScore, int& outBestMoves,
-                       int threadCount)
+                       int threadCount, FitnessCost* outCost)
 {
+    using Clock = std::chrono::steady_clock;
+
     double total = 0.0;
     outBestScore = 0.0;
     outBestMoves = 0;
+    FitnessCost cost;
 
     const int workers = (threadCount > 0)
         ? threadCount
@@ -207,6 +274,48 @@ double evaluateFitness(const Weights& w, int games, int maxMoves,
     const int remainder = games % tasks;
 
     std::mutex aggMutex;
+    auto playRange = [&](int taskStart, int taskEnd) {
+        double localTotal = 0.0;
+        double localBestScore = 0.0;
+        int    localBestMoves = 0;
+        FitnessCost localCost;
+
+        for (int idx = taskStart; idx < taskEnd; ++idx) {
+            int moves = 0;
+            const Clock::time_point gameStart = Clock::now();
+            double score = seedBegin
+                ? playSeededGame(w, *seedBegin + idx, maxMoves, &moves)
+                : playOneGame(w, maxMoves, &moves);
+            localCost.seconds += std::chrono::duration<double>(
+                Clock::now() - gameStart).count();
+            localCost.moves += moves;
+
+            localTotal += score;
+            if (isBetterGame(score, moves, localBestScore, localBestMoves)) {
+                localBestScore = score;
+                localBestMoves = moves;
+            }
+        }
+
+        TRACE_SCOPE("runGames: wait for result lock");
+        std::scoped_lock lock(aggMutex);
+        total += localTotal;
+        cost.moves   += localCost.moves;
+        cost.seconds += localCost.seconds;
+        if (isBetterGame(localBestScore, localBestMoves, outBestScore, outBestMoves)) {
+            outBestScore = localBestScore;
+            outBestMoves = localBestMoves;
+        }
+    };
+
+    // A single task runs on the caller's thread, which keeps whatever
+    // placement the caller gave it.
+    if (tasks == 1) {
+        playRange(0, games);
+        if (outCost) *outCost = cost;
+        return (games > 0) ? (total / games) : 0.0;
+    }
+
     std::vector<std::future<void>> futures;
     futures.reserve(tasks);
 
@@ -219,72 +328,73 @@ double evaluateFitness(const Weights& w, int games, int maxMoves,
 
         futures.emplace_back(std::async(std::launch::async,
             [&, taskStart, taskEnd]() {
-                double localTotal = 0.0;
-                double localBestScore = 0.0;
-                int    localBestMoves = 0;
-
-                for (int idx = taskStart; idx < taskEnd; ++idx) {
-                    (void)idx; // suppress unused warning
-                    int moves = 0;
-                    double score = playOneGame(w, maxMoves, &moves);
-
-                    localTotal += score;
-                    if (score > localBestScore) {
-                        localBestScore = score;
-                        localBestMoves = moves;
-                    }
-                }
-
-                std::scoped_lock lock(aggMutex);
-                total += localTotal;
-                if (localBestScore > outBestScore) {
-                    outBestScore = localBestScore;
-                    outBestMoves = localBestMoves;
-                }
+                pinSimulationThread();
+                playRange(taskStart, taskEnd);
             }
         ));
     }
 
-    for (auto& f : futures) {
-        f.get();
+    {
+        TRACE_SCOPE("runGames: wait for tasks");
+        for (auto& f : futures) {
+            f.get();
+        }
     }
 
+    if (outCost) *outCost = cost;
     return (games > 0) ? (total / games) : 0.0;
 }
 
+double evaluateFitness(const Weights& w, int games, int maxMoves,
+                       double& outBestScore, int& outBestMoves,
+                       int threadCount, FitnessCost* outCost)
+{
+    TRACE_SCOPE("evaluateFitness");
+    return runGames(w, nullptr, games, maxMoves,
+                    outBestScore, outBestMoves, threadCount, outCost);
+}
+
+double evaluateFitnessSeeded(const Weights& w, std::uint32_t seedBegin,
+                             int games, int maxMoves,
+                             double& outBestScore, int& outBestMoves,
+                             int threadCount, FitnessCost* outCost)
+{
+    TRACE_SCOPE("evaluateFitnessSeeded");
+    return runGames(w, &seedBegin, games, maxMoves,
+                    outBestScore, outBestMoves, threadCount, outCost);
+}
+
+// One generator per thread: std::mt19937 is not safe to share.
+static std::mt19937& rng() {
+    thread_local std::mt19937 gen(std::random_device{}());
+    return gen;
+}
+
 static double rnd(double a, double b) {
-    static std::mt19937 rng(std::random_device{}());
     std::uniform_real_distribution<double> dist(a, b);
-    return dist(rng);
+    return dist(rng());
 }
 
 Weights randomWeights() {
     Weights w;
-    w.wEmpty     = rnd(50, 300);
-    w.wMonotonic = rnd(10, 100);
-    w.wSmooth    = rnd(-10, -1);
-    w.wCornerMax = rnd(5000, 20000);
-    w.wMerge     = rnd(10, 200);
+    for (int i = 0; i < GeneCount; ++i)
+        w[i] = rnd(Genes[i].randomMin, Genes[i].randomMax);
     return w;
 }
 
 void mutateWeights(Weights& w, double rate)
 {
-    if (rnd(0,1) < rate) w.wEmpty     += rnd(-20, 20);
-    if (rnd(0,1) < rate) w.wMonotonic += rnd(-10, 10);
-    if (rnd(0,1) < rate) w.wSmooth    += rnd(-3, 3);
-    if (rnd(0,1) < rate) w.wCornerMax += rnd(-2000, 2000);
-    if (rnd(0,1) < rate) w.wMerge     += rnd(-20, 20);
+    for (int i = 0; i < GeneCount; ++i) {
+        const double step = Genes[i].mutationStep;
+        if (rnd(0,1) < rate) w[i] += rnd(-step, step);
+    }
 }
 
 Weights crossover(const Weights& a, const Weights& b)
 {
     Weights c;
-    c.wEmpty     = (rnd(0,1) < 0.5 ? a.wEmpty     : b.wEmpty);
-    c.wMonotonic = (rnd(0,1) < 0.5 ? a.wMonotonic : b.wMonotonic);
-    c.wSmooth    = (rnd(0,1) < 0.5 ? a.wSmooth    : b.wSmooth);
-    c.wCornerMax = (rnd(0,1) < 0.5 ? a.wCornerMax : b.wCornerMax);
-    c.wMerge     = (rnd(0,1) < 0.5 ? a.wMerge     : b.wMerge);
+    for (int i = 0; i < GeneCount; ++i)
+        c[i] = (rnd(0,1) < 0.5 ? a[i] : b[i]);
     return c;
 }
 
@@ -302,90 +412,253 @@ Population createInitialPopulation(int size)
 
 Population evolve(const Population& pop, double eliteRate, double mutationRate)
 {
-    int size = (int)pop.size();
-    int eliteCount = std::max(1, int(size * eliteRate));
+    TRACE_SCOPE("evolve");
+    GenomeTable next;
+    evolveTable(GenomeTable(pop), next, eliteRate, mutationRate,
+                (std::uint64_t(rng()()) << 32) | rng()());
+    return next.toPopulation();
+}
 
-    Population newPop;
-    newPop.reserve(size);
+std::uint64_t hashWeights(const Weights& w)
+{
+    // FNV-1a over the raw bytes; weights are only ever copied, never
+    // recomputed, so identical genomes have identical bits.
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    for (int f = 0; f < GeneCount; ++f) {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(&w[f]);
+        for (std::size_t i = 0; i < sizeof(double); ++i) {
+            h ^= p[i];
+            h *= 0x100000001b3ULL;
+        }
+    }
+    return h;
+}
 
-    Population sorted = pop;
-    std::sort(sorted.begin(), sorted.end(),
-              [](auto& a, auto& b){ return a.fitness > b.fitness; });
+bool sameWeights(const Weights& a, const Weights& b)
+{
+    for (int i = 0; i < GeneCount; ++i)
+        if (a[i] != b[i]) return false;
+    return true;
+}
 
-    for (int i = 0; i < eliteCount; ++i)
-        newPop.push_back(sorted[i]);
+const FitnessRecord* FitnessCache::find(const Weights& w) const
+{
+    auto it = m_records.find(hashWeights(w));
+    if (it == m_records.end() || !sameWeights(it->second.w, w)) return nullptr;
+    return &it->second;
+}
 
-    while ((int)newPop.size() < size)
-    {
-        const Individual& p1 = sorted[rnd(0,1) < 0.5 ? 0 : (int)rnd(1, sorted.size()-1)];
-        const Individual& p2 = sorted[rnd(0,1) < 0.5 ? 0 : (int)rnd(1, sorted.size()-1)];
+const FitnessRecord& FitnessCache::merge(const FitnessRecord& r)
+{
+    FitnessRecord& dst = m_records[hashWeights(r.w)];
+    if (dst.games == 0 || !sameWeights(dst.w, r.w)) {
+        dst = r;
+        return dst;
+    }
 
-        Individual child;
-        child.w = crossover(p1.w, p2.w);
-        mutateWeights(child.w, mutationRate);
-        child.fitness   = 0.0;
-        child.bestScore = 0.0;
-        child.bestMoves = 0;
+    dst.games += r.games;
+    dst.total += r.total;
+    dst.cost.moves   += r.cost.moves;
+    dst.cost.seconds += r.cost.seconds;
+    if (isBetterGame(r.bestScore, r.bestMoves, dst.bestScore, dst.bestMoves)) {
+        dst.bestScore = r.bestScore;
+        dst.bestMoves = r.bestMoves;
+    }
+    return dst;
+}
 
-        newPop.push_back(child);
+void FitnessCache::retain(const Population& pop)
+{
+    std::unordered_map<std::uint64_t, FitnessRecord> kept;
+    for (const Individual& ind : pop) {
+        auto it = m_records.find(hashWeights(ind.w));
+        if (it != m_records.end() && sameWeights(it->second.w, ind.w))
+            kept.insert(*it);
     }
+    m_records.swap(kept);
+}
 
-    return newPop;
+static FitnessRecord playGames(const Weights& w, int games, int maxMoves, int threadCount)
+{
+    FitnessRecord r;
+    r.w = w;
+    r.games = games;
+    if (games <= 0) return r;
+
+    r.total = evaluateFitness(w, games, maxMoves,
+                              r.bestScore, r.bestMoves, threadCount, &r.cost) * games;
+    return r;
 }
 
-void evaluatePopulation(Population& pop, int games, int maxMoves, int threadCount)
+void evaluatePopulation(Population& pop, int games, int maxMoves, int threadCount,
+                        FitnessCache* cache, int topUpGames)
 {
+    TRACE_SCOPE("evaluatePopulation");
     for (auto& ind : pop) {
-        double bestScore = 0.0;
-        int    bestMoves = 0;
-
-        ind.fitness = evaluateFitness(ind.w,
-                                      games,
-                                      maxMoves,
-                                      bestScore,
-                                      bestMoves,
-                                      threadCount);
-
-        ind.bestScore = bestScore;
-        ind.bestMoves = bestMoves;
+        FitnessRecord result;
+
+        if (!cache) {
+            result = playGames(ind.w, games, maxMoves, threadCount);
+        } else {
+            const FitnessRecord* known = cache->find(ind.w);
+            const int have = known ? known->games : 0;
+            const int extra = (have >= games) ? topUpGames : games - have;
+
+            cache->reusedGames += have;
+            cache->playedGames += extra;
+            result = (extra > 0 || !known)
+                ? cache->merge(playGames(ind.w, extra, maxMoves, threadCount))
+                : *known;
+        }
+
+        ind.fitness   = result.mean();
+        ind.bestScore = result.bestScore;
+        ind.bestMoves = result.bestMoves;
+        ind.msPerMove = result.cost.msPerMove();
     }
 }
 
+bool parseCostModel(const std::string& spec, CostModel& out)
+{
+    CostModel cost;
+    if (spec == "score") {
+        cost.kind = CostModel::Kind::ScoreOnly;
+    } else if (spec == "pareto") {
+        cost.kind = CostModel::Kind::Pareto;
+    } else if (spec.rfind("budget:", 0) == 0) {
+        cost.kind = CostModel::Kind::Budget;
+        std::istringstream ss(spec.substr(7));
+        if (!(ss >> cost.budgetMsPerMove) || cost.budgetMsPerMove <= 0.0) return false;
+    } else {
+        return false;
+    }
+    out = cost;
+    return true;
+}
+
+void applyCostModel(Population& pop, const CostModel& cost)
+{
+    if (cost.kind == CostModel::Kind::Budget) {
+        for (auto& ind : pop) {
+            if (ind.msPerMove > cost.budgetMsPerMove)
+                ind.fitness *= cost.budgetMsPerMove / ind.msPerMove;
+        }
+        return;
+    }
+    if (cost.kind != CostModel::Kind::Pareto || pop.empty()) return;
+
+    // Peel off non-dominated fronts: higher score and lower ms/move are
+    // both better.
+    auto dominates = [](const Individual& a, const Individual& b) {
+        return a.fitness >= b.fitness && a.msPerMove <= b.msPerMove
+            && (a.fitness > b.fitness || a.msPerMove < b.msPerMove);
+    };
+    std::vector<int> front(pop.size(), -1);
+    std::size_t ranked = 0;
+    int fronts = 0;
+    for (; ranked < pop.size(); ++fronts) {
+        std::vector<std::size_t> current;
+        for (std::size_t i = 0; i < pop.size(); ++i) {
+            if (front[i] >= 0) continue;
+            bool dominated = false;
+            for (std::size_t j = 0; j < pop.size() && !dominated; ++j)
+                dominated = j != i && front[j] < 0 && dominates(pop[j], pop[i]);
+            if (!dominated) current.push_back(i);
+        }
+        for (std::size_t i : current) front[i] = fronts;
+        ranked += current.size();
+    }
+
+    double maxScore = 0.0;
+    for (const auto& ind : pop) maxScore = std::max(maxScore, ind.fitness);
+    for (std::size_t i = 0; i < pop.size(); ++i)
+        pop[i].fitness = (fronts - 1 - front[i]) + pop[i].fitness / (maxScore + 1.0);
+}
+
+void writeGeneHeader(std::ostream& os)
+{
+    os << "genes";
+    for (int i = 0; i < GeneCount; ++i)
+        os << ' ' << Genes[i].name;
+    os << '\n';
+}
+
+// One individual per line: the genes in genome order, as the "genes" line
+// names them, then fitness, bestScore and bestMoves.
 static void writeIndividual(std::ostream& os, const Individual& ind)
 {
-    os << ind.w.wEmpty << ' '
-       << ind.w.wMonotonic << ' '
-       << ind.w.wSmooth << ' '
-       << ind.w.wCornerMax << ' '
-       << ind.w.wMerge << ' '
-       << ind.fitness << ' '
+    for (int i = 0; i < GeneCount; ++i)
+        os << ind.w[i] << ' ';
+    os << ind.fitness << ' '
        << ind.bestScore << ' '
        << ind.bestMoves << '\n';
 }
 
+void writePopulation(std::ostream& os, const Population& pop, int generation)
+{
+    os << generation << '\n';
+    os << pop.size() << '\n';
+    writeGeneHeader(os);
+    // Enough digits that weights read back exactly.
+    const std::streamsize precision = os.precision(17);
+    for (const auto& ind : pop) {
+        writeIndividual(os, ind);
+    }
+    os.precision(precision);
+}
+
 bool savePopulation(const Population& pop, int generation, const std::string& filePath)
 {
+    TRACE_SCOPE("savePopulation");
     std::ofstream ofs(filePath, std::ios::out | std::ios::trunc);
     if (!ofs.is_open()) return false;
 
-    ofs << generation << '\n';
-    ofs << pop.size() << '\n';
-    for (const auto& ind : pop) {
-        writeIndividual(ofs, ind);
+    writePopulation(ofs, pop, generation);
+    return true;
+}
+
+bool readGeneHeader(const std::string& line, std::vector<int>& columns)
+{
+    std::istringstream ls(line);
+    std::string word;
+    if (!(ls >> word) || word != "genes") return false;
+
+    columns.clear();
+    while (ls >> word) {
+        int gene = -1;
+        for (int i = 0; i < GeneCount && gene < 0; ++i)
+            if (word == Genes[i].name) gene = i;
+        columns.push_back(gene);
     }
     return true;
 }
 
-static bool readIndividual(std::istream& is, Individual& ind)
+// With columns from a "genes" line, values are read by name; genes the
+// file does not name keep their defaults. Files from before that line
+// list the genes in genome order, and lines saved before a gene was
+// appended carry fewer of them.
+static bool readIndividual(const std::string& line, const std::vector<int>& columns,
+                           Individual& ind)
 {
-    return static_cast<bool>(is >> ind.w.wEmpty
-                               >> ind.w.wMonotonic
-                               >> ind.w.wSmooth
-                               >> ind.w.wCornerMax
-                               >> ind.w.wMerge
-                               >> ind.fitness
-                               >> ind.bestScore
-                               >> ind.bestMoves);
+    std::istringstream ls(line);
+    std::vector<double> values;
+    double v = 0.0;
+    while (ls >> v) values.push_back(v);
+
+    const int weights = (int)values.size() - 3;
+    if (columns.empty()) {
+        if (weights < 1 || weights > GeneCount) return false;
+        for (int i = 0; i < weights; ++i)
+            ind.w[i] = values[i];
+    } else {
+        if (weights != (int)columns.size()) return false;
+        for (int k = 0; k < weights; ++k)
+            if (columns[k] >= 0) ind.w[columns[k]] = values[k];
+    }
+    ind.fitness   = values[weights];
+    ind.bestScore = values[weights + 1];
+    ind.bestMoves = (int)values[weights + 2];
+    return true;
 }
 
 Population loadPopulation(const std::string& filePath, int expectedSize, int& outGeneration)
@@ -409,9 +682,12 @@ Population loadPopulation(const std::string& filePath, int expectedSize, int& ou
 
     Population pop;
     pop.reserve(size);
-    for (int i = 0; i < size; ++i) {
+    std::vector<int> columns;
+    std::string line;
+    while ((int)pop.size() < size && std::getline(ifs >> std::ws, line)) {
+        if (pop.empty() && columns.empty() && readGeneHeader(line, columns)) continue;
         Individual ind;
-        if (!readIndividual(ifs, ind)) break;
+        if (!readIndividual(line, columns, ind)) break;
         pop.push_back(ind);
     }
 
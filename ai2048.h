@@ -3,7 +3,11 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
+#include <iosfwd>
+#include <unordered_map>
 #include "game2048.h"
+#include "features2048.h"
 
 enum class Direction {
     Left,
@@ -12,47 +16,214 @@ enum class Direction {
     Down
 };
 
+// Genes that set how hard a player searches rather than how it scores a
+// board. They evolve with the feature weights: searchDepth rounds to the
+// expectimax depth of fitness games (1 = greedy chooseMove), searchCutoff
+// is the spawn probability below which that search stops expanding.
+// New entries go at the end, as for features.
+//
+//                gene          default  random range   mutation
+#define AI2048_SEARCH_GENES(X) \
+    X(searchDepth,     1.0,     1.0,   2.0,     0.5) \
+    X(searchCutoff,    0.0,     0.0,   0.01,    0.002)
+
+constexpr int SearchGeneCount = 0
+#define AI2048_COUNT_GENE(name, def, lo, hi, step) + 1
+    AI2048_SEARCH_GENES(AI2048_COUNT_GENE)
+#undef AI2048_COUNT_GENE
+    ;
+
+// Everything the genetic algorithm evolves: the feature weights first, in
+// registry order, then the search genes.
+constexpr int GeneCount = FeatureCount + SearchGeneCount;
+
+// Deepest search a searchDepth gene can ask for.
+constexpr int MaxGeneSearchDepth = 3;
+
 struct Weights {
-    double wEmpty     = 200.0;
-    double wMonotonic = 50.0;
-    double wSmooth    = -3.0;
-    double wCornerMax = 10000.0;
-    double wMerge     = 100.0;
+#define AI2048_WEIGHT_FIELD(name, F, def, lo, hi, step) double name = def;
+    AI2048_FEATURES(AI2048_WEIGHT_FIELD)
+#undef AI2048_WEIGHT_FIELD
+#define AI2048_GENE_FIELD(name, def, lo, hi, step) double name = def;
+    AI2048_SEARCH_GENES(AI2048_GENE_FIELD)
+#undef AI2048_GENE_FIELD
+
+    // Gene i in genome order, i < GeneCount.
+    double&       operator[](int i);
+    const double& operator[](int i) const;
+};
+
+struct FeatureInfo {
+    const char* name;
+    double Weights::* weight;
+    double randomMin;
+    double randomMax;
+    double mutationStep;
+};
+
+inline constexpr FeatureInfo Genes[] = {
+#define AI2048_FEATURE_INFO(name, F, def, lo, hi, step) { #name, &Weights::name, lo, hi, step },
+    AI2048_FEATURES(AI2048_FEATURE_INFO)
+#undef AI2048_FEATURE_INFO
+#define AI2048_GENE_INFO(name, def, lo, hi, step) { #name, &Weights::name, lo, hi, step },
+    AI2048_SEARCH_GENES(AI2048_GENE_INFO)
+#undef AI2048_GENE_INFO
 };
 
+// The feature weights are the first FeatureCount genes.
+inline constexpr const FeatureInfo* Features = Genes;
+
+inline double&       Weights::operator[](int i)       { return this->*Genes[i].weight; }
+inline const double& Weights::operator[](int i) const { return this->*Genes[i].weight; }
+
+int    searchDepthOf(const Weights& w);
+double searchCutoffOf(const Weights& w);
+
 double evaluateBoard(const Game2048& game, const Weights& w);
 
 Direction chooseMove(const Game2048& game, const Weights& w);
 
+class GameRecorder;
+
+// While a recorder is set, every game played by playOneGame, playSeededGame
+// and the fitness functions is appended to it; nullptr stops recording.
+void setGameRecorder(GameRecorder* recorder);
+
 double playOneGame(const Weights& w,
                    int maxMoves = 1000,
                    int* outMoves = nullptr);
 
+double playSeededGame(const Weights& w,
+                      std::uint32_t seed,
+                      int maxMoves = 1000,
+                      int* outMoves = nullptr);
+
+// Compute spent by a set of games: moves played and the seconds they took.
+struct FitnessCost {
+    long long moves   = 0;
+    double    seconds = 0.0;
+
+    double msPerMove() const { return moves > 0 ? seconds * 1000.0 / moves : 0.0; }
+};
+
+// threadCount 1 plays every game on the calling thread.
 double evaluateFitness(const Weights& w,
                        int games,
                        int maxMoves,
                        double& outBestScore,
                        int& outBestMoves,
-                       int threadCount = 0);
+                       int threadCount = 0,
+                       FitnessCost* outCost = nullptr);
+
+// Same as evaluateFitness, but game i is played with seed seedBegin + i,
+// so any split of the seed range aggregates to the same result.
+double evaluateFitnessSeeded(const Weights& w,
+                             std::uint32_t seedBegin,
+                             int games,
+                             int maxMoves,
+                             double& outBestScore,
+                             int& outBestMoves,
+                             int threadCount = 0,
+                             FitnessCost* outCost = nullptr);
+
+// Ties on score go to the shorter game so that results do not depend on
+// the order in which games were aggregated.
+inline bool isBetterGame(double score, int moves, double bestScore, int bestMoves) {
+    return score > bestScore || (score == bestScore && moves < bestMoves);
+}
 
 struct Individual {
     Weights w;
     double fitness   = 0.0;
     double bestScore = 0.0;
     int    bestMoves = 0;
+    double msPerMove = 0.0;   // measured by the last evaluation, not saved
 };
 
 using Population = std::vector<Individual>;
 
+std::uint64_t hashWeights(const Weights& w);
+// Equal hashes only make a match likely; this confirms it.
+bool sameWeights(const Weights& a, const Weights& b);
+
+// Accumulated results of every game played with one set of weights.
+struct FitnessRecord {
+    Weights w;
+    int     games     = 0;
+    double  total     = 0.0;
+    double  bestScore = 0.0;
+    int     bestMoves = 0;
+    FitnessCost cost;
+
+    double mean() const { return games > 0 ? total / games : 0.0; }
+};
+
+// Fitness results keyed by hashWeights(), so elites and duplicate children
+// reuse earlier games instead of replaying them. Not thread-safe.
+class FitnessCache {
+public:
+    const FitnessRecord* find(const Weights& w) const;
+    const FitnessRecord& merge(const FitnessRecord& r);
+    // Drops every record whose weights are not in pop; called with the
+    // freshly bred generation, it keeps the cache at one population.
+    void retain(const Population& pop);
+    void clear() { m_records.clear(); }
+    std::size_t size() const { return m_records.size(); }
+
+    long long playedGames = 0;
+    long long reusedGames = 0;
+
+private:
+    std::unordered_map<std::uint64_t, FitnessRecord> m_records;
+};
+
 Weights randomWeights();
 void mutateWeights(Weights& w, double rate = 0.1);
 Weights crossover(const Weights& a, const Weights& b);
 
 Population createInitialPopulation(int size);
+
+// How measured compute enters fitness. With Budget, a player slower than
+// budgetMsPerMove keeps only budget / msPerMove of its mean score. With
+// Pareto, players are ranked into fronts of score against ms/move; fitness
+// is then the number of fronts above the worst one plus the mean score
+// scaled into [0, 1), so any player on a better front outranks every player
+// on a worse one.
+struct CostModel {
+    enum class Kind { ScoreOnly, Budget, Pareto };
+
+    Kind   kind            = Kind::ScoreOnly;
+    double budgetMsPerMove = 1.0;
+};
+
+// "score", "budget:<ms per move>" or "pareto".
+bool parseCostModel(const std::string& spec, CostModel& out);
+
+// Rewrites fitness, which must hold the mean score as evaluatePopulation()
+// leaves it, using each individual's msPerMove.
+void applyCostModel(Population& pop, const CostModel& cost);
+// Sets fitness to the mean score and msPerMove to the measured cost.
+// With a cache, individuals already evaluated over at least `games` games
+// keep their result and only play topUpGames more; others play whatever
+// is missing to reach `games`.
 void evaluatePopulation(Population& pop,
                         int games = 10,
                         int maxMoves = 1000,
-                        int threadCount = 0);
+                        int threadCount = 0,
+                        FitnessCache* cache = nullptr,
+                        int topUpGames = 0);
+
+// The "genes" line of population and hall of fame files names the gene
+// columns that follow. readGeneHeader() maps each column to a gene of this
+// build, -1 for genes it does not have, so files stay readable as the
+// registries change.
+void writeGeneHeader(std::ostream& os);
+bool readGeneHeader(const std::string& line, std::vector<int>& columns);
+
+// The population file format: the generation, the size, a "genes" line,
+// then one individual per line. loadPopulation() reads genes by name.
+// checkpoint2048.h writes it in the background.
+void writePopulation(std::ostream& os, const Population& pop, int generation);
 
 bool savePopulation(const Population& pop,
                     int generation,
@@ -62,6 +233,9 @@ Population loadPopulation(const std::string& filePath,
                           int expectedSize,
                           int& outGeneration);
 
+// Runs evolveTable() (genometable2048.h) on a column-wise copy and copies
+// the result back. The copies are linear in population size, which is
+// nothing beside the games that measured its fitness.
 Population evolve(const Population& pop,
                   double eliteRate = 0.1,
                   double mutationRate = 0.1);
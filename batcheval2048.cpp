@@ -0,0 +1,244 @@
+#include "batcheval2048.h"
+#include "trace2048.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define BATCHEVAL_X86 1
+#endif
+
+namespace {
+
+// Features are whole numbers on exponents; the weighted sum is taken in
+// registry order, as the fused evaluator does, so both give identical doubles.
+struct WeightRow {
+    double v[FeatureCount];
+    explicit WeightRow(const Weights& w) {
+        for (int i = 0; i < FeatureCount; ++i) v[i] = w[i];
+    }
+};
+
+inline double combine(const WeightRow& w, int empty, int mono, int penalty,
+                      bool corner, int merges) {
+    double f[FeatureCount] = {};
+    setFeature<EmptyFeature>(f, empty);
+    setFeature<MonotonicFeature>(f, mono);
+    setFeature<SmoothFeature>(f, -penalty);
+    setFeature<CornerMaxFeature>(f, corner ? 1.0 : -1.0);
+    setFeature<MergeFeature>(f, merges);
+
+    double score = 0.0;
+    for (int i = 0; i < FeatureCount; ++i) score += w.v[i] * f[i];
+    return score;
+}
+
+double evaluateScalar(Board64 b, int n, const WeightRow& w) {
+    auto at = [b](int i) { return int((b >> (4 * i)) & 0xF); };
+
+    int empty = 0, mono = 0, penalty = 0, merges = 0, maxE = 0;
+    auto pair = [&](int a, int c) {
+        if (a == 0 || c == 0) return;
+        mono += (a >= c) ? 1 : -1;
+        penalty += std::abs(a - c);
+        if (a == c) ++merges;
+    };
+
+    for (int r = 0; r < n; ++r) {
+        for (int c = 0; c < n; ++c) {
+            const int i = r * n + c;
+            const int v = at(i);
+            if (v == 0) ++empty;
+            maxE = std::max(maxE, v);
+            if (c + 1 < n) pair(v, at(i + 1));
+            if (r + 1 < n) pair(v, at(i + n));
+        }
+    }
+
+    const bool corner = at(0) == maxE || at(n - 1) == maxE
+                     || at(n * n - n) == maxE || at(n * n - 1) == maxE;
+    return combine(w, empty, mono, penalty, corner, merges);
+}
+
+void evaluateScalar4(const Board64* boards, std::size_t count, const WeightRow& w, double* out) {
+    for (std::size_t i = 0; i < count; ++i) out[i] = evaluateScalar(boards[i], 4, w);
+}
+
+#ifdef BATCHEVAL_X86
+
+// With one byte per cell (cell i in byte i), a cell's right neighbour is one
+// byte up and the one below it four bytes up. These bits mark the cells
+// that have such a neighbour.
+constexpr unsigned kHasRight = 0x7777;
+constexpr unsigned kHasBelow = 0x0FFF;
+constexpr unsigned kCorners  = 0x9009;
+
+__attribute__((target("sse4.1,popcnt")))
+inline int popcount(unsigned x) {
+    return _mm_popcnt_u32(x);
+}
+
+// Mono and merge counts from the per-cell masks of one board.
+__attribute__((target("sse4.1,popcnt")))
+inline void pairCounts(unsigned nz, unsigned geH, unsigned geV, unsigned eqH, unsigned eqV,
+                       int& mono, int& merges) {
+    const unsigned pairH = nz & (nz >> 1) & kHasRight;
+    const unsigned pairV = nz & (nz >> 4) & kHasBelow;
+    mono = 2 * (popcount(geH & pairH) + popcount(geV & pairV))
+         - popcount(pairH) - popcount(pairV);
+    merges = popcount(eqH & pairH) + popcount(eqV & pairV);
+}
+
+__attribute__((target("sse4.1,popcnt")))
+void evaluateSse41(const Board64* boards, std::size_t count, const WeightRow& w, double* out) {
+    const __m128i nibble  = _mm_set1_epi8(0x0F);
+    const __m128i zero    = _mm_setzero_si128();
+    const __m128i hasRight = _mm_set1_epi32(0x00FFFFFF);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        const __m128i x  = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(boards + i));
+        const __m128i lo = _mm_and_si128(x, nibble);
+        const __m128i hi = _mm_and_si128(_mm_srli_epi64(x, 4), nibble);
+        const __m128i e  = _mm_unpacklo_epi8(lo, hi);
+        const __m128i right = _mm_srli_si128(e, 1);
+        const __m128i below = _mm_srli_si128(e, 4);
+
+        const __m128i isZero = _mm_cmpeq_epi8(e, zero);
+        const unsigned zeroBits = unsigned(_mm_movemask_epi8(isZero));
+        const unsigned nz = ~zeroBits & 0xFFFF;
+
+        int mono = 0, merges = 0;
+        pairCounts(nz,
+                   unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(e, right), e))),
+                   unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(e, below), e))),
+                   unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(e, right))),
+                   unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(e, below))),
+                   mono, merges);
+
+        // |a - b| over pairs of non-empty cells, summed with psadbw.
+        const __m128i nzv = _mm_xor_si128(isZero, _mm_set1_epi8(-1));
+        const __m128i pairH = _mm_and_si128(_mm_and_si128(nzv, _mm_srli_si128(nzv, 1)), hasRight);
+        const __m128i pairV = _mm_and_si128(nzv, _mm_srli_si128(nzv, 4));
+        const __m128i diffH = _mm_or_si128(_mm_subs_epu8(e, right), _mm_subs_epu8(right, e));
+        const __m128i diffV = _mm_or_si128(_mm_subs_epu8(e, below), _mm_subs_epu8(below, e));
+        const __m128i diff  = _mm_add_epi8(_mm_and_si128(diffH, pairH), _mm_and_si128(diffV, pairV));
+        const __m128i sad   = _mm_sad_epu8(diff, zero);
+        const int penalty = _mm_cvtsi128_si32(sad) + _mm_extract_epi16(sad, 4);
+
+        __m128i m = _mm_max_epu8(e, _mm_srli_si128(e, 8));
+        m = _mm_max_epu8(m, _mm_srli_si128(m, 4));
+        m = _mm_max_epu8(m, _mm_srli_si128(m, 2));
+        m = _mm_max_epu8(m, _mm_srli_si128(m, 1));
+        m = _mm_shuffle_epi8(m, zero);
+        const bool corner = (unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(e, m))) & kCorners) != 0;
+
+        out[i] = combine(w, popcount(zeroBits), mono, penalty, corner, merges);
+    }
+}
+
+// Same computation with one board in each 128-bit lane; AVX2 byte shifts
+// and shuffles stay within a lane, which is exactly what is wanted here.
+__attribute__((target("avx2,popcnt")))
+void evaluateAvx2(const Board64* boards, std::size_t count, const WeightRow& w, double* out) {
+    const __m128i nibble  = _mm_set1_epi8(0x0F);
+    const __m256i zero    = _mm256_setzero_si256();
+    const __m256i ones    = _mm256_set1_epi8(-1);
+    const __m256i hasRight = _mm256_set1_epi32(0x00FFFFFF);
+
+    std::size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const __m128i x  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(boards + i));
+        const __m128i lo = _mm_and_si128(x, nibble);
+        const __m128i hi = _mm_and_si128(_mm_srli_epi64(x, 4), nibble);
+        const __m256i e  = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_unpacklo_epi8(lo, hi)), _mm_unpackhi_epi8(lo, hi), 1);
+        const __m256i right = _mm256_srli_si256(e, 1);
+        const __m256i below = _mm256_srli_si256(e, 4);
+
+        const __m256i isZero = _mm256_cmpeq_epi8(e, zero);
+        const unsigned zeroBits = unsigned(_mm256_movemask_epi8(isZero));
+        const unsigned nz = ~zeroBits;
+        const unsigned geH = unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(e, right), e)));
+        const unsigned geV = unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(e, below), e)));
+        const unsigned eqH = unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(e, right)));
+        const unsigned eqV = unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(e, below)));
+
+        const __m256i nzv = _mm256_xor_si256(isZero, ones);
+        const __m256i pairH = _mm256_and_si256(_mm256_and_si256(nzv, _mm256_srli_si256(nzv, 1)), hasRight);
+        const __m256i pairV = _mm256_and_si256(nzv, _mm256_srli_si256(nzv, 4));
+        const __m256i diffH = _mm256_or_si256(_mm256_subs_epu8(e, right), _mm256_subs_epu8(right, e));
+        const __m256i diffV = _mm256_or_si256(_mm256_subs_epu8(e, below), _mm256_subs_epu8(below, e));
+        const __m256i diff  = _mm256_add_epi8(_mm256_and_si256(diffH, pairH),
+                                              _mm256_and_si256(diffV, pairV));
+        alignas(32) std::uint64_t sad[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(sad), _mm256_sad_epu8(diff, zero));
+
+        __m256i m = _mm256_max_epu8(e, _mm256_srli_si256(e, 8));
+        m = _mm256_max_epu8(m, _mm256_srli_si256(m, 4));
+        m = _mm256_max_epu8(m, _mm256_srli_si256(m, 2));
+        m = _mm256_max_epu8(m, _mm256_srli_si256(m, 1));
+        m = _mm256_shuffle_epi8(m, zero);
+        const unsigned atMax = unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(e, m)));
+
+        for (int k = 0; k < 2; ++k) {
+            const int shift = 16 * k;
+            int mono = 0, merges = 0;
+            pairCounts((nz >> shift) & 0xFFFF, (geH >> shift) & 0xFFFF, (geV >> shift) & 0xFFFF,
+                       (eqH >> shift) & 0xFFFF, (eqV >> shift) & 0xFFFF, mono, merges);
+            out[i + k] = combine(w, popcount((zeroBits >> shift) & 0xFFFF), mono,
+                                 int(sad[2 * k] + sad[2 * k + 1]),
+                                 ((atMax >> shift) & kCorners) != 0, merges);
+        }
+    }
+    if (i < count) evaluateSse41(boards + i, count - i, w, out + i);
+}
+
+#endif // BATCHEVAL_X86
+
+using Kernel = void (*)(const Board64*, std::size_t, const WeightRow&, double*);
+
+struct KernelChoice {
+    Kernel      fn;
+    const char* name;
+};
+
+KernelChoice pickKernel() {
+#ifdef BATCHEVAL_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("popcnt")) {
+        if (__builtin_cpu_supports("avx2"))   return {evaluateAvx2, "avx2"};
+        if (__builtin_cpu_supports("sse4.1")) return {evaluateSse41, "sse4.1"};
+    }
+#endif
+    return {evaluateScalar4, "scalar"};
+}
+
+const KernelChoice& kernel() {
+    static const KernelChoice choice = pickKernel();
+    return choice;
+}
+
+} // namespace
+
+void evaluateBoards(const Board64* boards, std::size_t count, int n,
+                    const Weights& w, double* out)
+{
+    TRACE_SCOPE("evaluateBoards");
+    if (!BuiltinFeatureSet) {
+        for (std::size_t i = 0; i < count; ++i) out[i] = evaluateBoard(unpackBoard(boards[i], n), w);
+        return;
+    }
+    const WeightRow row(w);
+    if (n == 4) {
+        kernel().fn(boards, count, row, out);
+        return;
+    }
+    for (std::size_t i = 0; i < count; ++i) out[i] = evaluateScalar(boards[i], n, row);
+}
+
+const char* evaluateBoardsKernel()
+{
+    if (!BuiltinFeatureSet) return "generic";
+    return kernel().name;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+#include "ai2048.h"
+#include "bitboard2048.h"
+
+// Scores count packed n x n boards (n <= 4) into out, giving the same values
+// evaluateBoard() gives for the unpacked boards.
+//
+// 4x4 boards go through a SIMD kernel picked once from what the CPU
+// supports: AVX2 scores two boards per instruction, SSE4.1 one, and other
+// sizes or CPUs use a plain loop over the nibbles. A feature registry the
+// kernels do not know unpacks every board for evaluateBoard().
+void evaluateBoards(const Board64* boards, std::size_t count, int n,
+                    const Weights& w, double* out);
+
+// "avx2", "sse4.1", "scalar" or "generic".
+const char* evaluateBoardsKernel();
@@ -0,0 +1,160 @@
+#include "bitboard2048.h"
+#include "game2048.h"
+
+#include <algorithm>
+
+bool packBoard(const Game2048& game, Board64& out)
+{
+    const int n = game.size();
+    if (n * n > 16) return false;
+
+    Board64 b = 0;
+    for (int r = 0; r < n; ++r) {
+        for (int c = 0; c < n; ++c) {
+            unsigned v = static_cast<unsigned>(game.at(r, c));
+            if (v == 0) continue;
+
+            int e = 0;
+            while ((1u << e) < v) ++e;
+            if (e > 15) return false;
+
+            b |= Board64(e) << (4 * (r * n + c));
+        }
+    }
+    out = b;
+    return true;
+}
+
+Game2048 unpackBoard(Board64 b, int n)
+{
+    // Constructing a game seeds it from std::random_device; copying a
+    // blank one is far cheaper. Every cell is overwritten below.
+    thread_local const Game2048 blanks[4] = {Game2048(1), Game2048(2), Game2048(3), Game2048(4)};
+    Game2048 game = blanks[std::clamp(n, 1, 4) - 1];
+    game.setAutoSpawn(false);
+    for (int r = 0; r < n; ++r) {
+        for (int c = 0; c < n; ++c) {
+            const int e = int((b >> (4 * (r * n + c))) & 0xF);
+            game.setTile(r, c, e ? (1 << e) : 0);
+        }
+    }
+    return game;
+}
+
+static Board64 transposeBoard(Board64 b)
+{
+    // Swap the off-diagonal nibbles of each 2x2 block, then the 2x2 blocks.
+    Board64 a1 = b & 0xF0F00F0FF0F00F0FULL;
+    Board64 a2 = b & 0x0000F0F00000F0F0ULL;
+    Board64 a3 = b & 0x0F0F00000F0F0000ULL;
+    Board64 a  = a1 | (a2 << 12) | (a3 >> 12);
+    Board64 b1 = a & 0xFF00FF0000FF00FFULL;
+    Board64 b2 = a & 0x00FF00FF00000000ULL;
+    Board64 b3 = a & 0x00000000FF00FF00ULL;
+    return b1 | (b2 >> 24) | (b3 << 24);
+}
+
+// Reverses each row.
+static Board64 mirrorBoard(Board64 b)
+{
+    return ((b & 0x000F000F000F000FULL) << 12)
+         | ((b & 0x00F000F000F000F0ULL) << 4)
+         | ((b & 0x0F000F000F000F00ULL) >> 4)
+         | ((b & 0xF000F000F000F000ULL) >> 12);
+}
+
+// Reverses the row order.
+static Board64 flipBoard(Board64 b)
+{
+    return ((b & 0x000000000000FFFFULL) << 48)
+         | ((b & 0x00000000FFFF0000ULL) << 16)
+         | ((b & 0x0000FFFF00000000ULL) >> 16)
+         | ((b & 0xFFFF000000000000ULL) >> 48);
+}
+
+static Board64 rotateClockwise(Board64 b)
+{
+    return mirrorBoard(transposeBoard(b));
+}
+
+static Board64 applySymmetrySmall(Board64 b, int sym, int n)
+{
+    Board64 out = 0;
+    for (int r = 0; r < n; ++r) {
+        for (int c = 0; c < n; ++c) {
+            Board64 v = (b >> (4 * (r * n + c))) & 0xF;
+            int rr = r;
+            int cc = (sym >= 4) ? n - 1 - c : c;
+            for (int k = 0; k < (sym & 3); ++k) {
+                int t = rr;
+                rr = cc;
+                cc = n - 1 - t;
+            }
+            out |= v << (4 * (rr * n + cc));
+        }
+    }
+    return out;
+}
+
+// Symmetry 0 is the identity; 1-3 rotate by 90/180/270 degrees clockwise;
+// 4-7 mirror first. Bit operations on 4x4 boards, a nibble permutation on
+// smaller ones.
+static Board64 applySymmetry(Board64 b, int sym, int n)
+{
+    if (n != 4) return applySymmetrySmall(b, sym, n);
+
+    if (sym >= 4) b = mirrorBoard(b);
+    switch (sym & 3) {
+    case 1: return rotateClockwise(b);
+    case 2: return flipBoard(mirrorBoard(b));
+    case 3: return transposeBoard(mirrorBoard(b));
+    }
+    return b;
+}
+
+Board64 canonicalBoard(Board64 b, int n)
+{
+    Board64 best = b;
+    for (int sym = 1; sym < 8; ++sym)
+        best = std::min(best, applySymmetry(b, sym, n));
+    return best;
+}
+
+bool moveBoard(Board64 b, int dir, Board64& out, int n)
+{
+    Board64 result = 0;
+    for (int line = 0; line < n; ++line) {
+        // Cells of the line, starting at the edge the tiles move towards.
+        int idx[4];
+        for (int k = 0; k < n; ++k) {
+            switch (dir) {
+            case 0:  idx[k] = line * n + k;           break;
+            case 1:  idx[k] = line * n + n - 1 - k;   break;
+            case 2:  idx[k] = k * n + line;           break;
+            default: idx[k] = (n - 1 - k) * n + line; break;
+            }
+        }
+
+        int slid[4] = {0, 0, 0, 0};
+        int count = 0;
+        bool mergeable = false;
+        for (int k = 0; k < n; ++k) {
+            const int e = int((b >> (4 * idx[k])) & 0xF);
+            if (e == 0) continue;
+            if (mergeable && slid[count - 1] == e) {
+                if (e == 15) return false;
+                slid[count - 1] = e + 1;
+                mergeable = false;
+            } else {
+                slid[count++] = e;
+                mergeable = true;
+            }
+        }
+        for (int k = 0; k < count; ++k) result |= Board64(slid[k]) << (4 * idx[k]);
+    }
+
+    const Board64 used = (n >= 4) ? ~Board64(0) : (Board64(1) << (4 * n * n)) - 1;
+    if (result == (b & used)) return false;
+    out = result;
+    return true;
+}
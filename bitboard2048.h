@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+class Game2048;
+
+// A board packed as 4-bit log2 exponents, cell (r, c) in nibble r*n + c.
+// Covers every board up to 4x4 whose tiles stay at or below 32768.
+using Board64 = std::uint64_t;
+
+bool packBoard(const Game2048& game, Board64& out);
+// The n x n game holding b's tiles, with automatic spawns off.
+Game2048 unpackBoard(Board64 b, int n = 4);
+
+// Smallest of the eight rotations/reflections, so equivalent positions
+// share one key. Only sound for values that are themselves symmetric, such
+// as the tablebase's exact game values; evaluateBoard() prefers one
+// orientation, so the search cache does not use it.
+Board64 canonicalBoard(Board64 b, int n = 4);
+
+// Plays dir (Left, Right, Up, Down as in Direction) on a packed board
+// without spawning. False if nothing moves, or if a merge would produce a
+// tile above 32768, which no longer fits a nibble.
+bool moveBoard(Board64 b, int dir, Board64& out, int n = 4);
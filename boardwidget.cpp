@@ -1,5 +1,6 @@
 #include "boardwidget.h"
 #include "game2048.h"
+#include "trace2048.h"
 #include <QPainter>
 #include <algorithm>
 
@@ -30,6 +31,7 @@ QColor BoardWidget::textColor(int v) const {
 }
 
 void BoardWidget::paintEvent(QPaintEvent*) {
+    TRACE_SCOPE("BoardWidget::paintEvent");
     if (!m_game) return;
 
     QPainter p(this);
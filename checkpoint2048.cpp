@@ -0,0 +1,161 @@
+#include "checkpoint2048.h"
+#include "trace2048.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static void setError(std::string* error, const std::string& what)
+{
+    if (error) *error = what + ": " + std::strerror(errno);
+}
+
+bool writeFileAtomically(const std::string& path, const std::string& data, std::string* error)
+{
+    const std::string tmp = path + ".tmp";
+    std::FILE* f = std::fopen(tmp.c_str(), "wb");
+    if (!f) {
+        setError(error, "cannot create " + tmp);
+        return false;
+    }
+
+    bool ok = std::fwrite(data.data(), 1, data.size(), f) == data.size()
+           && std::fflush(f) == 0;
+#ifdef _WIN32
+    ok = ok && _commit(_fileno(f)) == 0;
+#else
+    ok = ok && ::fsync(::fileno(f)) == 0;
+#endif
+    if (!ok) setError(error, "cannot write " + tmp);
+    if (std::fclose(f) != 0 && ok) {
+        setError(error, "cannot write " + tmp);
+        ok = false;
+    }
+    if (!ok) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+
+#ifdef _WIN32
+    if (!MoveFileExA(tmp.c_str(), path.c_str(),
+                     MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+        if (error) *error = "cannot replace " + path;
+        std::remove(tmp.c_str());
+        return false;
+    }
+#else
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+        setError(error, "cannot replace " + path);
+        std::remove(tmp.c_str());
+        return false;
+    }
+    // The rename itself is only durable once the directory is synced.
+    const auto slash = path.rfind('/');
+    const std::string dir = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+    const int dirFd = ::open(dir.c_str(), O_RDONLY);
+    if (dirFd >= 0) {
+        ::fsync(dirFd);
+        ::close(dirFd);
+    }
+#endif
+    return true;
+}
+
+Checkpointer::Checkpointer(const std::string& path, int intervalMs)
+    : m_path(path)
+    , m_interval(std::chrono::milliseconds(std::max(0, intervalMs)))
+    , m_thread(&Checkpointer::run, this) {
+}
+
+Checkpointer::~Checkpointer() {
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stop = true;
+        m_urgent = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+void Checkpointer::submit(const Population& pop, int generation) {
+    {
+        std::scoped_lock lock(m_mutex);
+        if (m_hasPending) ++m_coalesced;
+        m_pending = pop;
+        m_pendingGeneration = generation;
+        m_hasPending = true;
+    }
+    m_cv.notify_all();
+}
+
+bool Checkpointer::flush(std::string* error) {
+    std::unique_lock lock(m_mutex);
+    m_urgent = true;
+    m_cv.notify_all();
+    m_cv.wait(lock, [this] { return !m_hasPending && !m_writing; });
+    m_urgent = false;
+    if (!m_error.empty() && error) *error = m_error;
+    return m_error.empty();
+}
+
+long long Checkpointer::written() const {
+    std::scoped_lock lock(m_mutex);
+    return m_written;
+}
+
+long long Checkpointer::coalesced() const {
+    std::scoped_lock lock(m_mutex);
+    return m_coalesced;
+}
+
+void Checkpointer::run() {
+    setTraceThreadName("checkpoint writer");
+    std::unique_lock lock(m_mutex);
+    for (;;) {
+        m_cv.wait(lock, [this] { return m_hasPending || m_stop; });
+        if (!m_hasPending) return;
+
+        // Hold off until the interval has passed; newer snapshots keep
+        // replacing the pending one meanwhile.
+        const Clock::time_point due = m_lastWrite + m_interval;
+        if (!m_urgent && m_written > 0 && Clock::now() < due) {
+            m_cv.wait_until(lock, due, [this] { return m_urgent; });
+            continue;
+        }
+
+        Population pop = std::move(m_pending);
+        const int generation = m_pendingGeneration;
+        m_pending.clear();
+        m_hasPending = false;
+        m_writing = true;
+        lock.unlock();
+
+        std::string error;
+        bool ok;
+        {
+            TRACE_SCOPE("Checkpointer: write");
+            std::ostringstream ss;
+            writePopulation(ss, pop, generation);
+            ok = writeFileAtomically(m_path, ss.str(), &error);
+        }
+
+        lock.lock();
+        m_writing = false;
+        m_lastWrite = Clock::now();
+        m_error = ok ? std::string() : error;
+        if (ok) ++m_written;
+        else std::fprintf(stderr, "checkpoint: %s\n", error.c_str());
+        m_cv.notify_all();
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "ai2048.h"
+
+// Writes population checkpoints on a background thread, so training goes
+// on while a save is in flight on slow storage.
+//
+// submit() takes a snapshot and returns at once. Each write goes to
+// "<path>.tmp", is fsynced and then renamed over path, so the file on disk
+// is always a complete checkpoint. Snapshots that arrive while a write is
+// running, or less than intervalMs after the last one, replace each other:
+// only the newest is written. Whatever is pending when the checkpointer is
+// destroyed is written before the destructor returns.
+class Checkpointer {
+public:
+    explicit Checkpointer(const std::string& path, int intervalMs = 0);
+    ~Checkpointer();
+
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+
+    void submit(const Population& pop, int generation);
+
+    // Waits until the newest snapshot is on disk, skipping the interval;
+    // false with the reason if the last write failed.
+    bool flush(std::string* error = nullptr);
+
+    long long written()   const;
+    long long coalesced() const;   // snapshots replaced before being written
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void run();
+
+    const std::string m_path;
+    const Clock::duration m_interval;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    Population m_pending;
+    int  m_pendingGeneration = 0;
+    bool m_hasPending = false;
+    bool m_writing    = false;
+    bool m_urgent     = false;   // flush() or shutdown: ignore the interval
+    bool m_stop       = false;
+    Clock::time_point m_lastWrite;
+    std::string m_error;
+    long long m_written   = 0;
+    long long m_coalesced = 0;
+
+    std::thread m_thread;   // last, so it starts after everything above
+};
+
+// Replaces path with data as one step: write to path + ".tmp", fsync, then
+// rename. false with the reason on failure, leaving path untouched.
+bool writeFileAtomically(const std::string& path, const std::string& data,
+                         std::string* error = nullptr);
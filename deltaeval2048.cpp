@@ -0,0 +1,155 @@
+#include "deltaeval2048.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+using Line = DeltaEvaluator::Line;
+
+Line scanLine(const int* v, int n) {
+    Line l;
+    for (int k = 0; k < n; ++k) {
+        if (v[k] == 0) ++l.empty;
+        l.maxE = std::int8_t(std::max<int>(l.maxE, v[k]));
+        if (k + 1 == n) continue;
+        const int a = v[k], b = v[k + 1];
+        if (a == 0 || b == 0) continue;
+        l.mono    += (a >= b) ? 1 : -1;
+        l.penalty += std::uint8_t(std::abs(a - b));
+        if (a == b) ++l.merges;
+    }
+    return l;
+}
+
+// Every 4-cell line, indexed by its four nibbles with the first cell lowest.
+const std::vector<Line>& lineTable4() {
+    static const std::vector<Line> table = [] {
+        std::vector<Line> t(1 << 16);
+        for (int i = 0; i < (1 << 16); ++i) {
+            const int v[4] = {i & 0xF, (i >> 4) & 0xF, (i >> 8) & 0xF, (i >> 12) & 0xF};
+            t[i] = scanLine(v, 4);
+        }
+        return t;
+    }();
+    return table;
+}
+
+int nibble(Board64 b, int i) {
+    return int((b >> (4 * i)) & 0xF);
+}
+
+Line rowLine(Board64 b, int n, int r) {
+    if (n == 4) return lineTable4()[(b >> (16 * r)) & 0xFFFF];
+    int v[4];
+    for (int k = 0; k < n; ++k) v[k] = nibble(b, r * n + k);
+    return scanLine(v, n);
+}
+
+Line columnLine(Board64 b, int n, int c) {
+    if (n == 4) {
+        const Board64 s = b >> (4 * c);
+        return lineTable4()[(s & 0xF) | ((s >> 12) & 0xF0) | ((s >> 24) & 0xF00)
+                            | ((s >> 36) & 0xF000)];
+    }
+    int v[4];
+    for (int k = 0; k < n; ++k) v[k] = nibble(b, k * n + c);
+    return scanLine(v, n);
+}
+
+} // namespace
+
+DeltaEvaluator::DeltaEvaluator(const Weights& w) : m_weights(w) {
+    for (int i = 0; i < FeatureCount; ++i) m_w[i] = w[i];
+}
+
+double DeltaEvaluator::combine(int empty, int mono, int penalty, bool corner, int merges) const {
+    double f[FeatureCount] = {};
+    setFeature<EmptyFeature>(f, empty);
+    setFeature<MonotonicFeature>(f, mono);
+    setFeature<SmoothFeature>(f, -penalty);
+    setFeature<CornerMaxFeature>(f, corner ? 1.0 : -1.0);
+    setFeature<MergeFeature>(f, merges);
+
+    double score = 0.0;
+    for (int i = 0; i < FeatureCount; ++i) score += m_w[i] * f[i];
+    return score;
+}
+
+bool DeltaEvaluator::cornerHoldsMax(const State& s) const {
+    int maxE = 0;
+    for (int r = 0; r < s.n; ++r) maxE = std::max<int>(maxE, s.rows[r].maxE);
+    const int n = s.n;
+    return nibble(s.board, 0) == maxE || nibble(s.board, n - 1) == maxE
+        || nibble(s.board, n * n - n) == maxE || nibble(s.board, n * n - 1) == maxE;
+}
+
+void DeltaEvaluator::rescan(State& s, unsigned rows, unsigned cols) const {
+    for (int r = 0; r < s.n; ++r) {
+        if (!(rows >> r & 1)) continue;
+        const Line old = s.rows[r];
+        const Line now = rowLine(s.board, s.n, r);
+        s.empty   += now.empty   - old.empty;
+        s.mono    += now.mono    - old.mono;
+        s.penalty += now.penalty - old.penalty;
+        s.merges  += now.merges  - old.merges;
+        s.rows[r] = now;
+    }
+    for (int c = 0; c < s.n; ++c) {
+        if (!(cols >> c & 1)) continue;
+        const Line old = s.cols[c];
+        const Line now = columnLine(s.board, s.n, c);
+        s.mono    += now.mono    - old.mono;
+        s.penalty += now.penalty - old.penalty;
+        s.merges  += now.merges  - old.merges;
+        s.cols[c] = now;
+    }
+    s.score = BuiltinFeatureSet
+        ? combine(s.empty, s.mono, s.penalty, cornerHoldsMax(s), s.merges)
+        : evaluateBoard(unpackBoard(s.board, s.n), m_weights);
+}
+
+DeltaEvaluator::State DeltaEvaluator::evaluate(Board64 b, int n) const {
+    State s;
+    s.board = b;
+    s.n     = n;
+    rescan(s, (1u << n) - 1, (1u << n) - 1);
+    return s;
+}
+
+DeltaEvaluator::State DeltaEvaluator::child(const State& parent, Board64 b) const {
+    State s = parent;
+    s.board = b;
+
+    unsigned rows = 0, cols = 0;
+    const Board64 diff = parent.board ^ b;
+    for (int i = 0; i < s.n * s.n; ++i) {
+        if (nibble(diff, i) == 0) continue;
+        rows |= 1u << (i / s.n);
+        cols |= 1u << (i % s.n);
+    }
+    if (rows != 0) rescan(s, rows, cols);
+    return s;
+}
+
+DeltaEvaluator::State DeltaEvaluator::spawn(const State& parent, int cell, int exponent) const {
+    return child(parent, parent.board | (Board64(exponent) << (4 * cell)));
+}
+
+double DeltaEvaluator::delta(const State& parent, Board64 b) const {
+    const State c = child(parent, b);
+    if (!BuiltinFeatureSet) return c.score - parent.score;
+    const int corner = (cornerHoldsMax(c) ? 1 : -1) - (cornerHoldsMax(parent) ? 1 : -1);
+
+    double f[FeatureCount] = {};
+    setFeature<EmptyFeature>(f, c.empty - parent.empty);
+    setFeature<MonotonicFeature>(f, c.mono - parent.mono);
+    setFeature<SmoothFeature>(f, -(c.penalty - parent.penalty));
+    setFeature<CornerMaxFeature>(f, corner);
+    setFeature<MergeFeature>(f, c.merges - parent.merges);
+
+    double d = 0.0;
+    for (int i = 0; i < FeatureCount; ++i) d += m_w[i] * f[i];
+    return d;
+}
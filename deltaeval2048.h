@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+#include "ai2048.h"
+#include "bitboard2048.h"
+
+// evaluateBoard() on packed boards, with the feature sums kept per row and
+// per column so that a child position only rescans the lines that differ
+// from its parent. A spawn touches one row and one column; a horizontal
+// move leaves the rows that did not slide alone.
+//
+// Scores are bit-identical to evaluateBoard() and evaluateBoards(): the
+// features are whole numbers, and the weighted sum is taken in registry
+// order from the updated totals. With a registry other than the built-in
+// five features, every state is scored by evaluateBoard() instead.
+class DeltaEvaluator {
+public:
+    // Features of one line, read from its first cell to its last. Rows own
+    // the empty cells; for columns only the pair terms count.
+    struct Line {
+        std::int8_t  empty   = 0;
+        std::int8_t  mono    = 0;
+        std::int8_t  merges  = 0;
+        std::int8_t  maxE    = 0;
+        std::uint8_t penalty = 0;
+    };
+
+    struct State {
+        Board64 board = 0;
+        int     n     = 4;
+        Line    rows[4];
+        Line    cols[4];
+        int     empty = 0, mono = 0, penalty = 0, merges = 0;
+        double  score = 0.0;
+    };
+
+    explicit DeltaEvaluator(const Weights& w);
+
+    // Full scan of an n x n board, n <= 4.
+    State evaluate(Board64 b, int n = 4) const;
+
+    // The state of b, a position reached from parent, rescanning only the
+    // rows and columns whose cells changed.
+    State child(const State& parent, Board64 b) const;
+
+    // A tile of 2^exponent appearing in empty cell `cell`.
+    State spawn(const State& parent, int cell, int exponent) const;
+
+    // child(parent, b).score - parent.score, taken from the feature
+    // differences alone. Adding it to parent.score can differ from the
+    // exact child score in the last bits.
+    double delta(const State& parent, Board64 b) const;
+
+private:
+    void   rescan(State& s, unsigned rows, unsigned cols) const;
+    double combine(int empty, int mono, int penalty, bool corner, int merges) const;
+    bool   cornerHoldsMax(const State& s) const;
+
+    Weights m_weights;          // for registries the line sums do not cover
+    double  m_w[FeatureCount];
+};
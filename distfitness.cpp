@@ -0,0 +1,450 @@
+#include "distfitness.h"
+#include "affinity2048.h"
+#include "netio.h"
+#include "gamearchive2048.h"
+#include "trace2048.h"
+
+#include <poll.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+using Clock = std::chrono::steady_clock;
+
+namespace {
+
+enum MessageType : std::uint8_t {
+    MsgHello       = 1,   // worker -> master: u32 version, u32 threads, u32 genes
+    MsgJobBatch    = 2,   // master -> worker: u32 count, jobs
+    MsgResultBatch = 3,   // worker -> master: u32 count, results
+    MsgHeartbeat   = 4,   // worker -> master while busy
+    MsgShutdown    = 5    // master -> worker
+};
+
+constexpr std::uint32_t kProtocolVersion = 4;
+constexpr int kHeartbeatIntervalMs = 1000;
+constexpr int kPollIntervalMs      = 200;
+
+void writeWeights(PayloadWriter& out, const Weights& w) {
+    for (int i = 0; i < GeneCount; ++i) out.f64(w[i]);
+}
+
+bool readWeights(PayloadReader& in, Weights& w) {
+    for (int i = 0; i < GeneCount; ++i)
+        if (!in.f64(w[i])) return false;
+    return true;
+}
+
+long long msSince(Clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - t).count();
+}
+
+} // namespace
+
+struct FitnessMaster::Worker {
+    int fd = -1;
+    int threads = 0;                     // from Hello; no jobs until it arrives
+    FrameReader reader;
+    Clock::time_point lastSeen;
+    std::vector<std::size_t> inflight;   // indices into the current job list
+};
+
+FitnessMaster::FitnessMaster(const std::string& endpoint, const DistributedOptions& opt)
+    : m_endpoint(endpoint), m_opt(opt) {
+}
+
+FitnessMaster::~FitnessMaster() {
+    for (auto& w : m_workers) closeSocket(w.fd);
+    closeSocket(m_listenFd);
+}
+
+int FitnessMaster::workerCount() const {
+    return (int)m_workers.size();
+}
+
+bool FitnessMaster::start(std::string* error) {
+    m_listenFd = listenOn(m_endpoint, error);
+    if (m_listenFd < 0) return false;
+    setNonBlocking(m_listenFd, true);
+    return true;
+}
+
+void FitnessMaster::acceptWorkers() {
+    for (;;) {
+        int fd = acceptClient(m_listenFd);
+        if (fd < 0) return;
+        setNonBlocking(fd, true);
+
+        Worker w;
+        w.fd = fd;
+        w.lastSeen = Clock::now();
+        m_workers.push_back(std::move(w));
+    }
+}
+
+void FitnessMaster::dropWorker(std::size_t index, std::vector<std::size_t>& queue) {
+    Worker& w = m_workers[index];
+    queue.insert(queue.end(), w.inflight.begin(), w.inflight.end());
+    closeSocket(w.fd);
+    m_workers.erase(m_workers.begin() + index);
+}
+
+bool FitnessMaster::run(const std::vector<FitnessJob>& jobs,
+                        std::vector<FitnessJobResult>& outResults)
+{
+    // Wire ids carry a per-run serial so a late answer from an earlier run
+    // can never be mistaken for a job of this one.
+    static std::uint32_t runSerial = 0;
+    const std::uint64_t serial = std::uint64_t(++runSerial) << 32;
+
+    outResults.assign(jobs.size(), FitnessJobResult());
+    std::vector<bool> done(jobs.size(), false);
+    std::size_t remaining = jobs.size();
+
+    std::vector<std::size_t> queue;
+    queue.reserve(jobs.size());
+    for (std::size_t i = jobs.size(); i-- > 0; ) queue.push_back(i);   // popped from the back
+
+    Clock::time_point lastWorker = Clock::now();
+
+    while (remaining > 0) {
+        // Hand a batch to every idle worker.
+        for (std::size_t wi = m_workers.size(); wi-- > 0; ) {
+            Worker& w = m_workers[wi];
+            if (w.threads == 0 || !w.inflight.empty() || queue.empty()) continue;
+
+            // A worker plays a batch's jobs side by side, so every one of
+            // its threads should get a job.
+            const int batchSize = std::max(m_opt.jobsPerBatch, w.threads);
+            PayloadWriter batch;
+            std::vector<std::size_t> picked;
+            while (!queue.empty() && (int)picked.size() < batchSize) {
+                std::size_t j = queue.back();
+                queue.pop_back();
+                if (!done[j]) picked.push_back(j);
+            }
+            if (picked.empty()) continue;
+
+            batch.u32((std::uint32_t)picked.size());
+            for (std::size_t j : picked) {
+                const FitnessJob& job = jobs[j];
+                batch.u64(serial | j);
+                writeWeights(batch, job.w);
+                batch.u32(job.seedBegin);
+                batch.i32(job.games);
+                batch.i32(job.maxMoves);
+                batch.u32(job.generation);
+            }
+
+            w.inflight = picked;
+            w.lastSeen = Clock::now();
+            if (!sendFrame(w.fd, MsgJobBatch, batch.data())) dropWorker(wi, queue);
+        }
+
+        std::vector<pollfd> fds;
+        fds.push_back({m_listenFd, POLLIN, 0});
+        for (const auto& w : m_workers) fds.push_back({w.fd, POLLIN, 0});
+        {
+            TRACE_SCOPE("FitnessMaster: wait for workers");
+            ::poll(fds.data(), fds.size(), kPollIntervalMs);
+        }
+
+        if (fds[0].revents & POLLIN) acceptWorkers();
+
+        // fds[1..] line up with the workers that existed before accepting.
+        for (std::size_t wi = fds.size() - 1; wi-- > 0; ) {
+            Worker& w = m_workers[wi];
+            bool alive = true;
+
+            if (fds[wi + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+                alive = w.reader.readFrom(w.fd);
+
+                Frame frame;
+                while (w.reader.next(frame)) {
+                    w.lastSeen = Clock::now();
+                    if (frame.type == MsgHello) {
+                        // Weights travel as GeneCount doubles; a worker built
+                        // with other gene registries cannot take part.
+                        PayloadReader in(frame.payload);
+                        std::uint32_t version = 0, threads = 0, genes = 0;
+                        if (!(in.u32(version) && in.u32(threads) && in.u32(genes))
+                            || version != kProtocolVersion || genes != GeneCount) {
+                            std::cerr << "fitness worker rejected: incompatible build" << std::endl;
+                            alive = false;
+                            break;
+                        }
+                        w.threads = int(std::max<std::uint32_t>(1, threads));
+                        continue;
+                    }
+                    if (frame.type != MsgResultBatch) continue;
+
+                    PayloadReader in(frame.payload);
+                    std::uint32_t count = 0;
+                    in.u32(count);
+                    for (std::uint32_t k = 0; k < count && in.ok(); ++k) {
+                        std::uint64_t id = 0, moves = 0;
+                        std::int32_t games = 0, bestMoves = 0;
+                        double total = 0.0, bestScore = 0.0, seconds = 0.0;
+                        if (!(in.u64(id) && in.i32(games) && in.f64(total)
+                              && in.f64(bestScore) && in.i32(bestMoves)
+                              && in.u64(moves) && in.f64(seconds))) break;
+                        if ((id & ~0xffffffffULL) != serial) continue;
+
+                        std::size_t j = std::size_t(id & 0xffffffffULL);
+                        if (j >= jobs.size()) continue;
+                        w.inflight.erase(std::remove(w.inflight.begin(), w.inflight.end(), j),
+                                         w.inflight.end());
+                        if (done[j]) continue;
+
+                        outResults[j] = FitnessJobResult{jobs[j].id, games, total,
+                                                         bestScore, bestMoves,
+                                                         {(long long)moves, seconds}};
+                        done[j] = true;
+                        --remaining;
+                    }
+                    if (!in.ok()) alive = false;
+                }
+                if (w.reader.corrupt()) alive = false;
+            }
+
+            if (alive && (w.threads == 0 || !w.inflight.empty())
+                && msSince(w.lastSeen) > m_opt.heartbeatTimeoutMs) {
+                std::cerr << "fitness worker timed out; reassigning "
+                          << w.inflight.size() << " jobs" << std::endl;
+                alive = false;
+            }
+            if (!alive) dropWorker(wi, queue);
+        }
+
+        if (!m_workers.empty()) {
+            lastWorker = Clock::now();
+        } else if (msSince(lastWorker) > m_opt.noWorkerTimeoutMs) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void FitnessMaster::shutdownWorkers() {
+    for (auto& w : m_workers) {
+        sendFrame(w.fd, MsgShutdown, {});
+        closeSocket(w.fd);
+    }
+    m_workers.clear();
+}
+
+bool evaluatePopulationDistributed(Population& pop, int games, int maxMoves,
+                                   std::uint32_t seedBase, FitnessMaster& master,
+                                   int generation, FitnessCache* cache, int topUpGames)
+{
+    TRACE_SCOPE("evaluatePopulationDistributed");
+    const int perJob = std::max(1, master.options().gamesPerJob);
+
+    // owner[i] is the first individual with pop[i]'s weights; only owners
+    // get jobs.
+    std::vector<std::size_t> owner(pop.size());
+    std::unordered_map<std::uint64_t, std::vector<std::size_t>> byHash;
+    std::vector<FitnessJob> jobs;
+    for (std::size_t i = 0; i < pop.size(); ++i) {
+        owner[i] = i;
+        auto& same = byHash[hashWeights(pop[i].w)];
+        for (std::size_t j : same) {
+            if (sameWeights(pop[j].w, pop[i].w)) {
+                owner[i] = j;
+                break;
+            }
+        }
+        if (owner[i] != i) continue;
+        same.push_back(i);
+
+        int play = games;
+        if (cache) {
+            const FitnessRecord* known = cache->find(pop[i].w);
+            const int have = known ? known->games : 0;
+            play = (have >= games) ? topUpGames : games - have;
+            cache->reusedGames += have;
+            cache->playedGames += play;
+        }
+
+        for (int first = 0; first < play; first += perJob) {
+            FitnessJob job;
+            job.id         = i;
+            job.w          = pop[i].w;
+            job.seedBegin  = seedBase + std::uint32_t(first);
+            job.games      = std::min(perJob, play - first);
+            job.maxMoves   = maxMoves;
+            job.generation = std::uint32_t(generation);
+            jobs.push_back(job);
+        }
+    }
+
+    std::vector<FitnessJobResult> results;
+    if (!master.run(jobs, results)) return false;
+
+    std::vector<FitnessRecord> records(pop.size());
+    for (std::size_t i = 0; i < pop.size(); ++i) records[i].w = pop[i].w;
+    for (const auto& r : results) {
+        FitnessRecord& rec = records[r.id];
+        rec.games += r.games;
+        rec.total += r.total;
+        rec.cost.moves   += r.cost.moves;
+        rec.cost.seconds += r.cost.seconds;
+        if (isBetterGame(r.bestScore, r.bestMoves, rec.bestScore, rec.bestMoves)) {
+            rec.bestScore = r.bestScore;
+            rec.bestMoves = r.bestMoves;
+        }
+    }
+    if (cache) {
+        for (std::size_t i = 0; i < pop.size(); ++i) {
+            if (owner[i] != i) continue;
+            const FitnessRecord* known = cache->find(pop[i].w);
+            records[i] = (records[i].games > 0 || !known) ? cache->merge(records[i]) : *known;
+        }
+    }
+
+    for (std::size_t i = 0; i < pop.size(); ++i) {
+        const FitnessRecord& rec = records[owner[i]];
+        pop[i].fitness   = rec.mean();
+        pop[i].bestScore = rec.bestScore;
+        pop[i].bestMoves = rec.bestMoves;
+        pop[i].msPerMove = rec.cost.msPerMove();
+    }
+    return true;
+}
+
+int runFitnessWorker(const std::string& endpoint, int threadCount, GameRecorder* recorder)
+{
+    int fd = -1;
+    std::string error;
+    for (int attempt = 0; attempt < 60 && fd < 0; ++attempt) {
+        fd = connectTo(endpoint, &error);
+        if (fd < 0) std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    }
+    if (fd < 0) {
+        std::cerr << "fitness worker: " << error << std::endl;
+        return 1;
+    }
+
+    std::mutex sendMutex;
+    auto send = [&](std::uint8_t type, const std::vector<std::uint8_t>& payload) {
+        std::scoped_lock lock(sendMutex);
+        return sendFrame(fd, type, payload);
+    };
+
+    const int threads = (threadCount > 0)
+        ? threadCount
+        : int(std::max(1u, std::thread::hardware_concurrency()));
+
+    PayloadWriter hello;
+    hello.u32(kProtocolVersion);
+    hello.u32(std::uint32_t(threads));
+    hello.u32(GeneCount);
+    if (!send(MsgHello, hello.data())) {
+        closeSocket(fd);
+        return 1;
+    }
+
+    setGameRecorder(recorder);
+
+    Frame frame;
+    while (recvFrame(fd, frame)) {
+        if (frame.type == MsgShutdown) break;
+        if (frame.type != MsgJobBatch) continue;
+
+        PayloadReader in(frame.payload);
+        std::uint32_t count = 0;
+        in.u32(count);
+
+        struct WireJob {
+            std::uint64_t id;
+            FitnessJob job;
+        };
+        std::vector<WireJob> jobs;
+        for (std::uint32_t k = 0; k < count; ++k) {
+            WireJob wj;
+            std::int32_t games = 0, maxMoves = 0;
+            if (!(in.u64(wj.id) && readWeights(in, wj.job.w) && in.u32(wj.job.seedBegin)
+                  && in.i32(games) && in.i32(maxMoves) && in.u32(wj.job.generation))) break;
+            wj.job.games    = games;
+            wj.job.maxMoves = maxMoves;
+            jobs.push_back(wj);
+        }
+        if (!in.ok()) break;
+
+        // Heartbeats keep the master from reassigning long batches.
+        std::mutex hbMutex;
+        std::condition_variable hbCv;
+        bool busy = true;
+        std::thread heartbeat([&] {
+            std::unique_lock lock(hbMutex);
+            while (!hbCv.wait_for(lock, std::chrono::milliseconds(kHeartbeatIntervalMs),
+                                  [&] { return !busy; })) {
+                send(MsgHeartbeat, {});
+            }
+        });
+
+        // Jobs run side by side, one thread each; a batch comes from a
+        // single master run, so all of it belongs to one generation.
+        struct Outcome {
+            double mean = 0.0;
+            double bestScore = 0.0;
+            int    bestMoves = 0;
+            FitnessCost cost;
+        };
+        std::vector<Outcome> outcomes(jobs.size());
+        if (recorder && !jobs.empty()) recorder->setGeneration(int(jobs.front().job.generation));
+
+        std::atomic<std::size_t> next{0};
+        auto play = [&]() {
+            pinSimulationThread();
+            for (std::size_t k; (k = next.fetch_add(1)) < jobs.size(); ) {
+                const FitnessJob& job = jobs[k].job;
+                Outcome& o = outcomes[k];
+                o.mean = evaluateFitnessSeeded(job.w, job.seedBegin, job.games, job.maxMoves,
+                                               o.bestScore, o.bestMoves, 1, &o.cost);
+            }
+        };
+        std::vector<std::future<void>> pool;
+        for (int t = 1; t < threads && std::size_t(t) < jobs.size(); ++t)
+            pool.emplace_back(std::async(std::launch::async, play));
+        play();
+        for (auto& f : pool) f.get();
+
+        PayloadWriter out;
+        out.u32((std::uint32_t)jobs.size());
+        for (std::size_t k = 0; k < jobs.size(); ++k) {
+            const Outcome& o = outcomes[k];
+            out.u64(jobs[k].id);
+            out.i32(jobs[k].job.games);
+            // Scores are whole numbers, so the total is recovered exactly.
+            out.f64(std::round(o.mean * jobs[k].job.games));
+            out.f64(o.bestScore);
+            out.i32(o.bestMoves);
+            out.u64(std::uint64_t(o.cost.moves));
+            out.f64(o.cost.seconds);
+        }
+
+        {
+            std::scoped_lock lock(hbMutex);
+            busy = false;
+        }
+        hbCv.notify_one();
+        heartbeat.join();
+
+        if (!send(MsgResultBatch, out.data())) break;
+    }
+
+    setGameRecorder(nullptr);
+    if (recorder) recorder->flush();
+    closeSocket(fd);
+    return 0;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ai2048.h"
+
+// Fitness evaluation spread over worker processes (see netio.h for the
+// endpoint syntax and frame format).
+//
+// The master hands out batches of jobs, each one a seed range to play with
+// one set of weights, with at least one job per thread the worker reported.
+// Workers play a batch's jobs in parallel, answer with per-job totals and
+// send heartbeats while busy; a worker that disconnects or goes silent has
+// its jobs queued again for the others. Because games are seeded, the aggregate equals
+// evaluateFitnessSeeded() over the whole range no matter how it was split.
+
+struct FitnessJob {
+    std::uint64_t id         = 0;
+    Weights       w;
+    std::uint32_t seedBegin  = 0;
+    int           games      = 0;
+    int           maxMoves   = 1000;
+    std::uint32_t generation = 0;   // stamped on games the worker records
+};
+
+struct FitnessJobResult {
+    std::uint64_t id        = 0;
+    int           games     = 0;
+    double        total     = 0.0;
+    double        bestScore = 0.0;
+    int           bestMoves = 0;
+    FitnessCost   cost;
+};
+
+struct DistributedOptions {
+    int gamesPerJob        = 4;
+    int jobsPerBatch       = 16;   // raised to a worker's thread count
+    int heartbeatTimeoutMs = 10000;
+    int noWorkerTimeoutMs  = 60000;   // give up if nobody connects for this long
+};
+
+class FitnessMaster {
+public:
+    explicit FitnessMaster(const std::string& endpoint,
+                           const DistributedOptions& opt = DistributedOptions());
+    ~FitnessMaster();
+
+    FitnessMaster(const FitnessMaster&) = delete;
+    FitnessMaster& operator=(const FitnessMaster&) = delete;
+
+    bool start(std::string* error = nullptr);
+
+    // Blocks until every job has a result; false if the workers all went
+    // away and none came back within noWorkerTimeoutMs.
+    bool run(const std::vector<FitnessJob>& jobs, std::vector<FitnessJobResult>& outResults);
+
+    int  workerCount() const;
+    void shutdownWorkers();
+
+    const DistributedOptions& options() const { return m_opt; }
+
+private:
+    struct Worker;
+
+    void acceptWorkers();
+    void dropWorker(std::size_t index, std::vector<std::size_t>& queue);
+
+    std::string m_endpoint;
+    DistributedOptions m_opt;
+    int m_listenFd = -1;
+    std::vector<Worker> m_workers;
+};
+
+// Plays seeds [seedBase, seedBase + games) for every individual on the
+// workers and fills in fitness, bestScore, bestMoves and msPerMove. With a
+// cache, weights played before only play the games they are missing, or
+// topUpGames more once they have enough, exactly as evaluatePopulation()
+// does; duplicates within pop are played once.
+bool evaluatePopulationDistributed(Population& pop,
+                                   int games,
+                                   int maxMoves,
+                                   std::uint32_t seedBase,
+                                   FitnessMaster& master,
+                                   int generation = 0,
+                                   FitnessCache* cache = nullptr,
+                                   int topUpGames = 0);
+
+// Connects to the master and serves jobs until told to stop; returns the
+// process exit code. With a recorder, every game played is archived under
+// the generation its job came from.
+int runFitnessWorker(const std::string& endpoint, int threadCount = 0,
+                     GameRecorder* recorder = nullptr);
@@ -0,0 +1,67 @@
+#include "evalcheck2048.h"
+#include "batcheval2048.h"
+#include "deltaeval2048.h"
+
+#include <random>
+#include <sstream>
+#include <vector>
+
+static bool reportMismatch(std::string* error, const char* what, Board64 b, int n,
+                           double got, double want)
+{
+    if (error) {
+        std::ostringstream os;
+        os.precision(17);
+        os << what << " differs on " << n << "x" << n << " board 0x" << std::hex << b
+           << std::dec << ": " << got << " instead of " << want;
+        *error = os.str();
+    }
+    return false;
+}
+
+bool checkPackedEvaluators(int boardsPerSize, std::uint32_t seed, std::string* error)
+{
+    std::mt19937 rng(seed);
+    for (int n = 2; n <= 4; ++n) {
+        // Sparse to full boards, with exponents low enough to leave room
+        // for merges.
+        std::vector<Board64> boards(std::size_t(std::max(0, boardsPerSize)));
+        for (Board64& b : boards) {
+            b = 0;
+            const unsigned fill = rng() % 101;
+            for (int i = 0; i < n * n; ++i) {
+                if (rng() % 100 < fill) b |= Board64(1 + rng() % 12) << (4 * i);
+            }
+        }
+
+        const Weights w = randomWeights();
+        const DeltaEvaluator delta(w);
+        std::vector<double> batch(boards.size());
+        evaluateBoards(boards.data(), boards.size(), n, w, batch.data());
+
+        for (std::size_t k = 0; k < boards.size(); ++k) {
+            const Board64 b = boards[k];
+            const double want = evaluateBoard(unpackBoard(b, n), w);
+            if (batch[k] != want) return reportMismatch(error, "evaluateBoards", b, n, batch[k], want);
+
+            const DeltaEvaluator::State s = delta.evaluate(b, n);
+            if (s.score != want) return reportMismatch(error, "DeltaEvaluator::evaluate", b, n, s.score, want);
+
+            for (int d = 0; d < 4; ++d) {
+                Board64 after;
+                if (!moveBoard(b, d, after, n)) continue;
+                const double afterWant = evaluateBoard(unpackBoard(after, n), w);
+                const double got = delta.child(s, after).score;
+                if (got != afterWant) return reportMismatch(error, "DeltaEvaluator::child", after, n, got, afterWant);
+            }
+            for (int cell = 0; cell < n * n; ++cell) {
+                if ((b >> (4 * cell)) & 0xF) continue;
+                const Board64 spawned = b | (Board64(1) << (4 * cell));
+                const double spawnWant = evaluateBoard(unpackBoard(spawned, n), w);
+                const double got = delta.spawn(s, cell, 1).score;
+                if (got != spawnWant) return reportMismatch(error, "DeltaEvaluator::spawn", spawned, n, got, spawnWant);
+            }
+        }
+    }
+    return true;
+}
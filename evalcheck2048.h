@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Self-check for the packed-board evaluators: evaluateBoards() and
+// DeltaEvaluator (full scans, every move's child and every spawn) must give
+// exactly evaluateBoard()'s score on random 2x2, 3x3 and 4x4 boards under
+// random weights. False, with the first mismatch in *error, otherwise.
+bool checkPackedEvaluators(int boardsPerSize = 10000, std::uint32_t seed = 1,
+                           std::string* error = nullptr);
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cmath>
+#include <type_traits>
+#include "game2048.h"
+
+// Board features scored by evaluateBoard.
+//
+// A feature is a small accumulator. cell() sees every tile, pair() sees every
+// horizontally or vertically adjacent pair (left/upper tile first), and
+// value() returns the raw feature once the pass is done. All features share
+// one pass over the board, and hooks a feature leaves empty compile away.
+//
+// AI2048_FEATURES is the registry. Each entry gives the weight's name, the
+// accumulator, the default weight, the range randomWeights() draws from and
+// the step mutateWeights() uses. Weights, the genome operators, population
+// files and the evaluator are all generated from it, so a new feature is a
+// struct plus one line here. Population files name their genes and are
+// read by name, so entries can be added, removed or reordered; a gene a
+// file does not name keeps its default.
+
+struct EmptyFeature {
+    void cell(int) {}
+    void pair(int, int) {}
+    double value(const Game2048& g) const { return g.emptyCount(); }
+};
+
+struct MonotonicFeature {
+    double score = 0.0;
+    void cell(int) {}
+    void pair(int a, int b) {
+        if (a != 0 && b != 0) score += (a >= b) ? 1.0 : -1.0;
+    }
+    double value(const Game2048&) const { return score; }
+};
+
+struct SmoothFeature {
+    double penalty = 0.0;
+    void cell(int) {}
+    void pair(int a, int b) {
+        if (a != 0 && b != 0) penalty += std::abs(std::log2((double)a) - std::log2((double)b));
+    }
+    double value(const Game2048&) const { return -penalty; }
+};
+
+struct CornerMaxFeature {
+    void cell(int) {}
+    void pair(int, int) {}
+    double value(const Game2048& g) const {
+        const int n = g.size();
+        const int maxVal = g.maxTile();
+        bool corner =
+            g.at(0, 0)     == maxVal ||
+            g.at(0, n-1)   == maxVal ||
+            g.at(n-1, 0)   == maxVal ||
+            g.at(n-1, n-1) == maxVal;
+        return corner ? 1.0 : -1.0;
+    }
+};
+
+struct MergeFeature {
+    int count = 0;
+    void cell(int) {}
+    void pair(int a, int b) {
+        if (a != 0 && a == b) ++count;
+    }
+    double value(const Game2048&) const { return count; }
+};
+
+//              weight      accumulator        default   random range        mutation
+#define AI2048_FEATURES(X) \
+    X(wEmpty,     EmptyFeature,         200.0,    50.0,    300.0,    20.0) \
+    X(wMonotonic, MonotonicFeature,      50.0,    10.0,    100.0,    10.0) \
+    X(wSmooth,    SmoothFeature,         -3.0,   -10.0,     -1.0,     3.0) \
+    X(wCornerMax, CornerMaxFeature,   10000.0,  5000.0,  20000.0,  2000.0) \
+    X(wMerge,     MergeFeature,         100.0,    10.0,    200.0,    20.0)
+
+enum class FeatureId {
+#define AI2048_FEATURE_ID(name, F, def, lo, hi, step) name,
+    AI2048_FEATURES(AI2048_FEATURE_ID)
+#undef AI2048_FEATURE_ID
+    Count
+};
+
+constexpr int FeatureCount = int(FeatureId::Count);
+
+// Registry index of the feature computed by accumulator F, or -1.
+template <typename F>
+constexpr int featureIndexOf() {
+    int index = -1, i = 0;
+#define AI2048_FEATURE_INDEX(name, Acc, def, lo, hi, step) \
+    if (std::is_same_v<F, Acc>) index = i; \
+    ++i;
+    AI2048_FEATURES(AI2048_FEATURE_INDEX)
+#undef AI2048_FEATURE_INDEX
+    return index;
+}
+
+// Stores v as F's entry of a per-feature array, if the registry has F.
+template <typename F>
+inline void setFeature(double* f, double v) {
+    constexpr int i = featureIndexOf<F>();
+    if constexpr (i >= 0) f[i] = v;
+}
+
+// The packed-board evaluators (batcheval2048.h, deltaeval2048.h) have
+// hand-written kernels for exactly the five features above and fall back to
+// evaluateBoard() for any other registry.
+constexpr bool BuiltinFeatureSet =
+    FeatureCount == 5
+    && featureIndexOf<EmptyFeature>() >= 0 && featureIndexOf<MonotonicFeature>() >= 0
+    && featureIndexOf<SmoothFeature>() >= 0 && featureIndexOf<CornerMaxFeature>() >= 0
+    && featureIndexOf<MergeFeature>() >= 0;
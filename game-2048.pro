@@ -9,19 +9,69 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    affinity2048.cpp \
     ai2048.cpp \
+    batcheval2048.cpp \
+    bitboard2048.cpp \
     boardwidget.cpp \
+    checkpoint2048.cpp \
+    deltaeval2048.cpp \
+    evalcheck2048.cpp \
     game2048.cpp \
+    gamearchive2048.cpp \
+    genometable2048.cpp \
+    halloffame2048.cpp \
     main.cpp \
     mainwindow.cpp \
-    populationwindow.cpp
+    ponder2048.cpp \
+    populationgrid.cpp \
+    populationwindow.cpp \
+    search2048.cpp \
+    surrogate2048.cpp \
+    sweep2048.cpp \
+    tablebase2048.cpp \
+    trace2048.cpp
 
 HEADERS += \
+    affinity2048.h \
     ai2048.h \
+    batcheval2048.h \
+    bitboard2048.h \
     boardwidget.h \
+    checkpoint2048.h \
+    deltaeval2048.h \
+    evalcheck2048.h \
+    features2048.h \
     game2048.h \
+    gamearchive2048.h \
+    genometable2048.h \
+    halloffame2048.h \
     mainwindow.h \
-    populationwindow.h
+    ponder2048.h \
+    populationgrid.h \
+    populationwindow.h \
+    search2048.h \
+    surrogate2048.h \
+    sweep2048.h \
+    tablebase2048.h \
+    trace2048.h
+
+# Scoped tracing to a Chrome trace file: qmake CONFIG+=trace, then run
+# with GAME2048_TRACE=<file>. Without it the trace points compile away.
+trace: DEFINES += AI2048_TRACE
+
+# Distributed fitness workers and the move service use POSIX sockets.
+unix {
+    SOURCES += \
+        distfitness.cpp \
+        moveservice.cpp \
+        netio.cpp
+
+    HEADERS += \
+        distfitness.h \
+        moveservice.h \
+        netio.h
+}
 
 # Default rules for deployment.
 qnx: target.path = /tmp/$${TARGET}/bin
@@ -1,8 +1,56 @@
 #include "game2048.h"
+#include "trace2048.h"
 #include <algorithm>
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+static int popcount64(std::uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(x);
+#else
+    int n = 0;
+    for (; x; x &= x - 1) ++n;
+    return n;
+#endif
+}
+
+static int lowestBit(std::uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#else
+    int i = 0;
+    while (!(x & 1)) { x >>= 1; ++i; }
+    return i;
+#endif
+}
+
+// Index of the k-th (0-based) set bit of mask.
+static int selectBit(std::uint64_t mask, int k) {
+#if defined(__BMI2__)
+    return lowestBit(_pdep_u64(std::uint64_t(1) << k, mask));
+#else
+    int base = 0;
+    for (;;) {
+        int inByte = popcount64(mask & 0xFF);
+        if (k < inByte) break;
+        k -= inByte;
+        mask >>= 8;
+        base += 8;
+    }
+    for (; k > 0; --k) mask &= mask - 1;
+    return base + lowestBit(mask);
+#endif
+}
+
+static int tileLog2(int v) {
+    int e = 0;
+    while ((1 << e) < v) ++e;
+    return e;
+}
 
 Game2048::Game2048(int size)
-    : m_n(size), m_score(0), m_board(size, std::vector<int>(size, 0)) {
+    : m_n(std::clamp(size, 1, MaxSize)), m_score(0) {
     std::random_device rd;
     m_rng.seed(rd());
     reset();
@@ -11,122 +59,144 @@ Game2048::Game2048(int size)
 void Game2048::reset() {
     m_score = 0;
     for (auto& row : m_board)
-        std::fill(row.begin(), row.end(), 0);
+        std::fill(std::begin(row), std::end(row), 0);
+
+    const int cells = m_n * m_n;
+    m_emptyMask  = (cells >= 64) ? ~std::uint64_t(0) : (std::uint64_t(1) << cells) - 1;
+    m_maxTile    = 0;
+    m_equalPairs = 0;
+    std::fill(std::begin(m_tileCount), std::end(m_tileCount), 0);
 
     spawnRandomTile();
     spawnRandomTile();
 }
 
-bool Game2048::slideAndMergeRowLeft(std::vector<int>& row) {
-    bool changed = false;
-    std::vector<int> original = row;
-    std::vector<int> tmp;
-    tmp.reserve(m_n);
-    for (int v : row) if (v != 0) tmp.push_back(v);
-    std::vector<int> merged;
-    merged.reserve(m_n);
-    for (int i = 0; i < (int)tmp.size(); ++i) {
-        if (i + 1 < (int)tmp.size() && tmp[i] == tmp[i + 1]) {
-            int nv = tmp[i] * 2;
-            merged.push_back(nv);
-            m_score += nv;
-            ++i;
-        } else {
-            merged.push_back(tmp[i]);
-        }
-    }
-    row.assign(m_n, 0);
-    for (int i = 0; i < (int)merged.size(); ++i)
-        row[i] = merged[i];
+void Game2048::reseed(std::uint32_t seed) {
+    m_rng.seed(seed);
+    reset();
+}
 
-    if (row != original) changed = true;
-    return changed;
+std::vector<std::vector<int>> Game2048::board() const {
+    std::vector<std::vector<int>> b(m_n);
+    for (int r = 0; r < m_n; ++r) b[r].assign(m_board[r], m_board[r] + m_n);
+    return b;
 }
 
-bool Game2048::moveLeft() {
-    bool changed = false;
-    for (auto& row : m_board)
-        changed |= slideAndMergeRowLeft(row);
+int Game2048::emptyCount() const {
+    return popcount64(m_emptyMask);
+}
 
-    if (changed) spawnRandomTile();
-    return changed;
+int Game2048::equalNeighbours(int r, int c, int value) const {
+    if (value == 0) return 0;
+    int k = 0;
+    if (c > 0       && m_board[r][c-1] == value) ++k;
+    if (c + 1 < m_n && m_board[r][c+1] == value) ++k;
+    if (r > 0       && m_board[r-1][c] == value) ++k;
+    if (r + 1 < m_n && m_board[r+1][c] == value) ++k;
+    return k;
 }
 
-bool Game2048::moveRight() {
-    bool changed = false;
-    for (auto& row : m_board) {
-        std::reverse(row.begin(), row.end());
-        changed |= slideAndMergeRowLeft(row);
-        std::reverse(row.begin(), row.end());
+// Every tile change goes through here to keep the summaries current.
+void Game2048::setCell(int r, int c, int value) {
+    const int old = m_board[r][c];
+    if (old == value) return;
+
+    m_equalPairs -= equalNeighbours(r, c, old);
+    m_board[r][c] = value;
+    m_equalPairs += equalNeighbours(r, c, value);
+
+    const std::uint64_t bit = std::uint64_t(1) << (r * m_n + c);
+    if (old != 0) --m_tileCount[tileLog2(old)];
+    else          m_emptyMask &= ~bit;
+    if (value != 0) ++m_tileCount[tileLog2(value)];
+    else            m_emptyMask |= bit;
+
+    if (value > m_maxTile) {
+        m_maxTile = value;
+    } else if (old == m_maxTile && m_tileCount[tileLog2(old)] == 0) {
+        int e = tileLog2(old);
+        while (e > 0 && m_tileCount[e] == 0) --e;
+        m_maxTile = (m_tileCount[e] > 0) ? (1 << e) : 0;
     }
-    if (changed) spawnRandomTile();
-    return changed;
 }
 
-bool Game2048::moveUp() {
-    bool changed = false;
-    for (int c = 0; c < m_n; ++c) {
-        std::vector<int> col(m_n);
-        for (int r = 0; r < m_n; ++r) col[r] = m_board[r][c];
+bool Game2048::slideAndMergeRowLeft(int* row) {
+    int tmp[MaxSize];
+    int count = 0;
+    for (int i = 0; i < m_n; ++i) if (row[i] != 0) tmp[count++] = row[i];
 
-        bool colChanged = slideAndMergeRowLeft(col);
-        changed |= colChanged;
+    int merged[MaxSize] = {};
+    int out = 0;
+    for (int i = 0; i < count; ++i) {
+        if (i + 1 < count && tmp[i] == tmp[i + 1]) {
+            int nv = tmp[i] * 2;
+            merged[out++] = nv;
+            m_score += nv;
+            ++i;
+        } else {
+            merged[out++] = tmp[i];
+        }
+    }
 
-        for (int r = 0; r < m_n; ++r) m_board[r][c] = col[r];
+    bool changed = false;
+    for (int i = 0; i < m_n; ++i) {
+        if (row[i] != merged[i]) changed = true;
+        row[i] = merged[i];
     }
-    if (changed) spawnRandomTile();
     return changed;
 }
 
-bool Game2048::moveDown() {
+// Slides every row (or column) towards index 0, or towards the far end when
+// reversed, writing back only the cells that changed.
+bool Game2048::moveLines(bool vertical, bool reversed) {
     bool changed = false;
-    for (int c = 0; c < m_n; ++c) {
-        std::vector<int> col(m_n);
-        for (int r = 0; r < m_n; ++r) col[r] = m_board[r][c];
-        std::reverse(col.begin(), col.end());
+    int line[MaxSize];
 
-        bool colChanged = slideAndMergeRowLeft(col);
-        changed |= colChanged;
+    for (int i = 0; i < m_n; ++i) {
+        for (int j = 0; j < m_n; ++j) {
+            int k = reversed ? m_n - 1 - j : j;
+            line[j] = vertical ? m_board[k][i] : m_board[i][k];
+        }
+
+        if (!slideAndMergeRowLeft(line)) continue;
+        changed = true;
 
-        std::reverse(col.begin(), col.end());
-        for (int r = 0; r < m_n; ++r) m_board[r][c] = col[r];
+        for (int j = 0; j < m_n; ++j) {
+            int k = reversed ? m_n - 1 - j : j;
+            if (vertical) setCell(k, i, line[j]);
+            else          setCell(i, k, line[j]);
+        }
     }
+
     if (changed) spawnRandomTile();
     return changed;
 }
 
+bool Game2048::moveLeft()  { TRACE_SCOPE("Game2048::moveLeft");  return moveLines(false, false); }
+bool Game2048::moveRight() { TRACE_SCOPE("Game2048::moveRight"); return moveLines(false, true);  }
+bool Game2048::moveUp()    { TRACE_SCOPE("Game2048::moveUp");    return moveLines(true,  false); }
+bool Game2048::moveDown()  { TRACE_SCOPE("Game2048::moveDown");  return moveLines(true,  true);  }
+
 void Game2048::spawnRandomTile() {
-    std::vector<std::pair<int,int>> empties;
-    empties.reserve(m_n*m_n);
-    for (int r=0;r<m_n;++r)
-        for (int c=0;c<m_n;++c)
-            if (m_board[r][c]==0) empties.push_back({r,c});
+    if (!m_autoSpawn) return;
 
-    if (empties.empty()) return;
+    if (m_emptyMask == 0) return;
 
-    std::uniform_int_distribution<int> posDist(0, (int)empties.size()-1);
-    auto [r,c] = empties[posDist(m_rng)];
+    // Row-major order of the mask matches the old vector of empties, so a
+    // given seed still produces the same games.
+    std::uniform_int_distribution<int> posDist(0, emptyCount() - 1);
+    int cell = selectBit(m_emptyMask, posDist(m_rng));
 
     std::uniform_int_distribution<int> valDist(1, 10);
-    m_board[r][c] = (valDist(m_rng)==10) ? 4 : 2;
+    setCell(cell / m_n, cell % m_n, (valDist(m_rng)==10) ? 4 : 2);
 }
 
 bool Game2048::isWin() const {
-    for (auto& row : m_board)
-        for (int v : row)
-            if (v == 2048) return true;
-    return false;
+    return m_tileCount[11] > 0;
 }
 
 bool Game2048::canMergeOrMove() const {
-    for (int r=0;r<m_n;++r){
-        for (int c=0;c<m_n;++c){
-            if (m_board[r][c]==0) return true;
-            if (c+1<m_n && m_board[r][c]==m_board[r][c+1]) return true;
-            if (r+1<m_n && m_board[r][c]==m_board[r+1][c]) return true;
-        }
-    }
-    return false;
+    return m_emptyMask != 0 || m_equalPairs != 0;
 }
 
 bool Game2048::isGameOver() const {
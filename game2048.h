@@ -1,12 +1,20 @@
 #pragma once
 #include <vector>
 #include <random>
+#include <cstdint>
 
+// Board sizes up to 8x8; the empty-cell set is kept as a 64-bit mask with
+// cell (r, c) at bit r*size + c. Cells are stored inline, so copying a game
+// does not allocate.
 class Game2048 {
 public:
+    static constexpr int MaxSize = 8;
+
     Game2048(int size = 4);
 
     void reset();
+    // Restarts the game with a fixed spawn sequence, for reproducible play.
+    void reseed(std::uint32_t seed);
     bool moveLeft();
     bool moveRight();
     bool moveUp();
@@ -17,17 +25,37 @@ public:
     int  score() const { return m_score; }
     int  size()  const { return m_n; }
 
+    // Maintained incrementally by every tile change, so these are O(1).
+    int           maxTile()    const { return m_maxTile; }
+    int           emptyCount() const;
+    std::uint64_t emptyMask()  const { return m_emptyMask; }
+
     int  at(int r, int c) const { return m_board[r][c]; }
-    const std::vector<std::vector<int>>& board() const { return m_board; }
+    void setTile(int r, int c, int value) { setCell(r, c, value); }
+    // Search copies turn this off so moves are deterministic and the
+    // caller places tiles itself via setTile().
+    void setAutoSpawn(bool on) { m_autoSpawn = on; }
+    // A copy of the cells, row by row.
+    std::vector<std::vector<int>> board() const;
 
 private:
     int m_n;
     int m_score;
-    std::vector<std::vector<int>> m_board;
+    int m_board[MaxSize][MaxSize] = {};
+
+    std::uint64_t m_emptyMask  = 0;
+    int           m_maxTile    = 0;
+    int           m_equalPairs = 0;    // adjacent non-zero tiles of equal value
+    int           m_tileCount[32] = {};  // tiles per log2 value
+
+    bool m_autoSpawn = true;
 
     std::mt19937 m_rng;
 
+    void setCell(int r, int c, int value);
+    int  equalNeighbours(int r, int c, int value) const;
+    bool moveLines(bool vertical, bool reversed);
     void spawnRandomTile();
     bool canMergeOrMove() const;
-    bool slideAndMergeRowLeft(std::vector<int>& row);
+    bool slideAndMergeRowLeft(int* row);
 };
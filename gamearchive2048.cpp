@@ -0,0 +1,476 @@
+#include "gamearchive2048.h"
+#include "trace2048.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <iomanip>
+#include <map>
+#include <ostream>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define GAMEARCHIVE_MMAP 1
+#endif
+
+namespace {
+
+// All fields are stored in host byte order.
+const char kMagic[8] = {'2', '0', '4', '8', 'G', 'A', '\0', '\1'};
+constexpr std::uint32_t kVersion    = 1;
+constexpr std::uint32_t kBlockMagic = 0x4b4c4247;   // "GBLK"
+constexpr std::size_t   kBlockBytes = 1 << 20;
+
+struct FileHeader {
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+};
+static_assert(sizeof(FileHeader) == 16, "archive header must stay packed");
+
+struct BlockHeader {
+    std::uint32_t magic;
+    std::uint32_t games;
+    std::uint64_t bytes;
+};
+static_assert(sizeof(BlockHeader) == 16, "archive block header must stay packed");
+
+enum GameFlags : std::uint8_t {
+    FlagSeeded   = 1,
+    FlagGameOver = 2
+};
+
+struct GameHeader {
+    std::uint64_t weightsHash;
+    std::uint32_t generation;
+    std::uint32_t seed;
+    std::uint32_t score;
+    std::uint32_t moves;
+    std::uint8_t  size;
+    std::uint8_t  maxExponent;
+    std::uint8_t  flags;
+    std::uint8_t  reserved;
+    std::uint32_t reserved2;
+};
+static_assert(sizeof(GameHeader) == 32, "archive game header must stay packed");
+
+template <typename T>
+void append(std::vector<std::uint8_t>& buf, const T& value) {
+    const auto* p = reinterpret_cast<const std::uint8_t*>(&value);
+    buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+} // namespace
+
+GameRecorder::~GameRecorder() {
+    close();
+}
+
+bool GameRecorder::open(const std::string& path, std::string* error) {
+    close();
+
+    FileHeader h;
+    bool fresh = true;
+    std::uint64_t fileSize = 0, validEnd = 0;
+    {
+        std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+        if (ifs.is_open() && (fileSize = std::uint64_t(ifs.tellg())) > 0) {
+            fresh = false;
+            ifs.seekg(0);
+            if (!ifs.read(reinterpret_cast<char*>(&h), sizeof(h))
+                || std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0
+                || h.version != kVersion) {
+                if (error) *error = path + " is not a game archive";
+                return false;
+            }
+
+            // Walk the block headers to the end of the last whole block.
+            validEnd = sizeof(h);
+            BlockHeader b;
+            while (fileSize - validEnd >= sizeof(b)
+                   && ifs.seekg(std::streamoff(validEnd))
+                   && ifs.read(reinterpret_cast<char*>(&b), sizeof(b))
+                   && b.magic == kBlockMagic && b.bytes <= fileSize - validEnd - sizeof(b)) {
+                validEnd += sizeof(b) + b.bytes;
+            }
+        }
+    }
+
+    // A block cut short by a crash would swallow whatever is appended
+    // after it, so it goes first.
+    if (!fresh && validEnd < fileSize) {
+        std::error_code ec;
+        std::filesystem::resize_file(path, validEnd, ec);
+        if (ec) {
+            if (error) *error = "cannot truncate " + path + ": " + ec.message();
+            return false;
+        }
+    }
+
+    m_out.open(path, std::ios::binary | std::ios::app);
+    if (!m_out.is_open()) {
+        if (error) *error = "cannot write " + path;
+        return false;
+    }
+    if (fresh) {
+        std::memcpy(h.magic, kMagic, sizeof(kMagic));
+        h.version = kVersion;
+        h.reserved = 0;
+        m_out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    }
+    m_block.reserve(kBlockBytes + 64 * 1024);
+    return static_cast<bool>(m_out);
+}
+
+void GameRecorder::close() {
+    std::scoped_lock lock(m_mutex);
+    if (!m_out.is_open()) return;
+    flushLocked();
+    m_out.close();
+}
+
+void GameRecorder::record(const GameRecord& game) {
+    GameHeader h{};
+    h.weightsHash = game.weightsHash;
+    h.generation  = game.generation;
+    h.seed        = game.seed;
+    h.score       = game.score;
+    h.moves       = std::uint32_t(game.moves.size());
+    h.size        = std::uint8_t(game.size);
+    h.maxExponent = game.maxExponent;
+    h.flags       = (game.seeded ? FlagSeeded : 0) | (game.gameOver ? FlagGameOver : 0);
+
+    std::scoped_lock lock(m_mutex);
+    if (!m_out.is_open()) return;
+    append(m_block, h);
+    const auto* p = reinterpret_cast<const std::uint8_t*>(game.moves.data());
+    m_block.insert(m_block.end(), p, p + game.moves.size() * sizeof(MoveSample));
+    ++m_blockGames;
+    if (m_block.size() >= kBlockBytes) flushLocked();
+}
+
+void GameRecorder::flush() {
+    std::scoped_lock lock(m_mutex);
+    if (!m_out.is_open()) return;
+    flushLocked();
+    m_out.flush();
+}
+
+void GameRecorder::flushLocked() {
+    if (m_blockGames == 0) return;
+    TRACE_SCOPE("GameRecorder: write block");
+    BlockHeader b{kBlockMagic, m_blockGames, m_block.size()};
+    m_out.write(reinterpret_cast<const char*>(&b), sizeof(b));
+    m_out.write(reinterpret_cast<const char*>(m_block.data()), std::streamsize(m_block.size()));
+    m_block.clear();
+    m_blockGames = 0;
+}
+
+double ArchiveGroupStats::scorePercentile(double p) const {
+    if (scores.empty()) return 0.0;
+    // Nearest rank.
+    double rank = std::ceil(p / 100.0 * double(scores.size()));
+    std::size_t i = std::size_t(std::clamp(rank, 1.0, double(scores.size()))) - 1;
+    return scores[i];
+}
+
+namespace {
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#ifdef GAMEARCHIVE_MMAP
+        if (m_map) ::munmap(m_map, m_size);
+#endif
+    }
+
+    bool open(const std::string& path) {
+#ifdef GAMEARCHIVE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || ::fstat(fd, &st) != 0) {
+            if (fd >= 0) ::close(fd);
+            return false;
+        }
+        m_size = std::size_t(st.st_size);
+        if (m_size > 0) {
+            void* map = ::mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (map == MAP_FAILED) {
+                ::close(fd);
+                return false;
+            }
+            ::madvise(map, m_size, MADV_SEQUENTIAL);
+            m_map = map;
+            m_data = static_cast<const std::uint8_t*>(map);
+        }
+        ::close(fd);
+        return true;
+#else
+        std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+        if (!ifs.is_open()) return false;
+        m_fallback.resize(std::size_t(ifs.tellg()));
+        ifs.seekg(0);
+        if (!ifs.read(reinterpret_cast<char*>(m_fallback.data()), std::streamsize(m_fallback.size())))
+            return false;
+        m_data = m_fallback.data();
+        m_size = m_fallback.size();
+        return true;
+#endif
+    }
+
+    const std::uint8_t* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+private:
+    const std::uint8_t* m_data = nullptr;
+    std::size_t m_size = 0;
+    void* m_map = nullptr;
+    std::vector<std::uint8_t> m_fallback;
+};
+
+struct Block {
+    const std::uint8_t* data;
+    std::size_t bytes;
+    std::uint32_t games;
+};
+
+using GroupMap = std::map<std::uint64_t, ArchiveGroupStats>;
+
+template <typename T>
+void addInto(std::vector<T>& dst, const std::vector<T>& src) {
+    if (dst.size() < src.size()) dst.resize(src.size(), T());
+    for (std::size_t i = 0; i < src.size(); ++i) dst[i] += src[i];
+}
+
+// Parses one block into the thread's groups; returns the bytes it had to skip.
+long long scanBlock(const Block& block, ArchiveGrouping grouping,
+                    int lengthBucket, int moveStep, GroupMap& groups) {
+    std::size_t off = 0;
+    for (std::uint32_t g = 0; g < block.games; ++g) {
+        GameHeader h;
+        if (block.bytes - off < sizeof(h)) return (long long)(block.bytes - off);
+        std::memcpy(&h, block.data + off, sizeof(h));
+        off += sizeof(h);
+        const std::size_t sampleBytes = std::size_t(h.moves) * sizeof(MoveSample);
+        if (block.bytes - off < sampleBytes) return (long long)(block.bytes - off + sizeof(h));
+        const std::uint8_t* samples = block.data + off;
+        off += sampleBytes;
+
+        const std::uint64_t key = (grouping == ArchiveGrouping::Generation)
+            ? h.generation : h.weightsHash;
+        ArchiveGroupStats& s = groups[key];
+        s.key = key;
+        ++s.games;
+        s.movesTotal += h.moves;
+        s.scoreTotal += h.score;
+        if (h.flags & FlagGameOver) ++s.gameOverCount;
+        ++s.maxTileCount[h.maxExponent & 31];
+        s.scores.push_back(h.score);
+
+        const std::size_t bucket = h.moves / std::uint32_t(lengthBucket);
+        if (s.lengthHistogram.size() <= bucket) s.lengthHistogram.resize(bucket + 1, 0);
+        ++s.lengthHistogram[bucket];
+
+        // Only every moveStep-th move is kept; row k is move (k + 1) * moveStep.
+        const std::size_t rows = h.moves / std::uint32_t(moveStep);
+        if (s.movesAlive.size() < rows) {
+            s.movesAlive.resize(rows, 0);
+            s.movesScoreSum.resize(rows, 0.0);
+            s.movesEmptySum.resize(rows, 0.0);
+            s.movesMaxExponentSum.resize(rows, 0.0);
+        }
+        for (std::size_t k = 0; k < rows; ++k) {
+            MoveSample m;
+            std::memcpy(&m, samples + ((k + 1) * moveStep - 1) * sizeof(MoveSample), sizeof(m));
+            ++s.movesAlive[k];
+            s.movesScoreSum[k]       += m.score;
+            s.movesEmptySum[k]       += m.emptyCells;
+            s.movesMaxExponentSum[k] += m.maxExponent;
+        }
+    }
+    return 0;
+}
+
+void mergeGroups(GroupMap& into, GroupMap& from) {
+    for (auto& [key, src] : from) {
+        ArchiveGroupStats& dst = into[key];
+        dst.key = key;
+        dst.games         += src.games;
+        dst.movesTotal    += src.movesTotal;
+        dst.gameOverCount += src.gameOverCount;
+        dst.scoreTotal    += src.scoreTotal;
+        for (int i = 0; i < 32; ++i) dst.maxTileCount[i] += src.maxTileCount[i];
+        dst.scores.insert(dst.scores.end(), src.scores.begin(), src.scores.end());
+        addInto(dst.lengthHistogram, src.lengthHistogram);
+        addInto(dst.movesAlive, src.movesAlive);
+        addInto(dst.movesScoreSum, src.movesScoreSum);
+        addInto(dst.movesEmptySum, src.movesEmptySum);
+        addInto(dst.movesMaxExponentSum, src.movesMaxExponentSum);
+    }
+    from.clear();
+}
+
+} // namespace
+
+bool analyzeArchives(const std::vector<std::string>& paths, ArchiveGrouping grouping,
+                     ArchiveSummary& out, int threadCount, int lengthBucket,
+                     int moveStep, std::string* error)
+{
+    const auto start = std::chrono::steady_clock::now();
+    out = ArchiveSummary();
+    out.lengthBucket = lengthBucket = std::max(1, lengthBucket);
+    out.moveStep = moveStep = std::max(1, moveStep);
+
+    std::vector<MappedFile> files(paths.size());
+    std::vector<Block> blocks;
+    for (std::size_t f = 0; f < paths.size(); ++f) {
+        MappedFile& file = files[f];
+        FileHeader h;
+        if (!file.open(paths[f]) || file.size() < sizeof(h)
+            || (std::memcpy(&h, file.data(), sizeof(h)),
+                std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion)) {
+            if (error) *error = paths[f] + " is not a game archive";
+            return false;
+        }
+
+        // Only the block headers are touched here; the games are parsed
+        // by the workers.
+        auto blockAt = [&](std::size_t off, BlockHeader& b) {
+            if (file.size() - off < sizeof(b)) return false;
+            std::memcpy(&b, file.data() + off, sizeof(b));
+            return b.magic == kBlockMagic && b.bytes <= file.size() - off - sizeof(b);
+        };
+        std::size_t off = sizeof(h);
+        while (off < file.size()) {
+            BlockHeader b;
+            if (!blockAt(off, b)) {
+                // A damaged block, say one an older recorder appended after:
+                // resume at the next block header.
+                std::size_t resume = off + 1;
+                while (resume < file.size() && !blockAt(resume, b)) ++resume;
+                out.skippedBytes += (long long)(resume - off);
+                off = resume;
+                continue;
+            }
+            blocks.push_back({file.data() + off + sizeof(b), std::size_t(b.bytes), b.games});
+            off += sizeof(b) + b.bytes;
+        }
+    }
+
+    const int workers = std::max(1, std::min<int>(
+        (threadCount > 0) ? threadCount : std::max(1u, std::thread::hardware_concurrency()),
+        (int)std::max<std::size_t>(1, blocks.size())));
+
+    std::atomic<std::size_t> next{0};
+    std::vector<GroupMap> partial(workers);
+    std::vector<long long> skipped(workers, 0);
+    std::vector<std::future<void>> futures;
+    for (int t = 0; t < workers; ++t) {
+        futures.emplace_back(std::async(std::launch::async, [&, t]() {
+            for (std::size_t i; (i = next++) < blocks.size(); )
+                skipped[t] += scanBlock(blocks[i], grouping, lengthBucket, moveStep, partial[t]);
+        }));
+    }
+    for (auto& f : futures) f.get();
+
+    // Pairwise merges, then the percentiles need every group sorted.
+    for (int step = 1; step < workers; step *= 2) {
+        futures.clear();
+        for (int t = 0; t + step < workers; t += 2 * step)
+            futures.emplace_back(std::async(std::launch::async, [&, t, step]() {
+                mergeGroups(partial[t], partial[t + step]);
+            }));
+        for (auto& f : futures) f.get();
+    }
+    for (long long s : skipped) out.skippedBytes += s;
+
+    for (auto& [key, stats] : partial[0]) {
+        out.games += stats.games;
+        out.groups.push_back(std::move(stats));
+    }
+    partial.clear();
+
+    next = 0;
+    futures.clear();
+    for (int t = 0; t < workers; ++t) {
+        futures.emplace_back(std::async(std::launch::async, [&]() {
+            for (std::size_t i; (i = next++) < out.groups.size(); )
+                std::sort(out.groups[i].scores.begin(), out.groups[i].scores.end());
+        }));
+    }
+    for (auto& f : futures) f.get();
+
+    out.elapsedMs = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+void printArchiveReport(const ArchiveSummary& summary, ArchiveGrouping grouping, std::ostream& os)
+{
+    const std::ios::fmtflags oldFlags = os.flags();
+    const std::streamsize oldPrecision = os.precision();
+    os << std::fixed << std::setprecision(1);
+
+    os << summary.games << " games in " << summary.groups.size() << " groups, scanned in "
+       << summary.elapsedMs << " ms";
+    if (summary.skippedBytes > 0) os << " (" << summary.skippedBytes << " bytes unreadable)";
+    os << "\n";
+
+    for (const ArchiveGroupStats& s : summary.groups) {
+        if (grouping == ArchiveGrouping::Generation) {
+            os << "\nGeneration " << s.key;
+        } else {
+            os << "\nWeights " << std::hex << std::setw(16) << std::setfill('0') << s.key
+               << std::dec << std::setfill(' ');
+        }
+        os << ": " << s.games << " games, mean score " << s.scoreTotal / s.games
+           << ", mean length " << double(s.movesTotal) / s.games << " moves, "
+           << 100.0 * s.gameOverCount / s.games << "% ended by game over\n";
+
+        os << "  score    p10 " << s.scorePercentile(10) << "  p50 " << s.scorePercentile(50)
+           << "  p90 " << s.scorePercentile(90) << "  p99 " << s.scorePercentile(99)
+           << "  max " << s.scorePercentile(100) << "\n";
+
+        os << "  max tile";
+        for (int e = 0; e < 32; ++e) {
+            if (s.maxTileCount[e] == 0) continue;
+            os << "  " << (e ? (1LL << e) : 0LL) << " "
+               << 100.0 * s.maxTileCount[e] / s.games << "%";
+        }
+        os << "\n";
+
+        os << "  length  ";
+        for (std::size_t b = 0; b < s.lengthHistogram.size(); ++b) {
+            if (s.lengthHistogram[b] == 0) continue;
+            os << "  " << b * summary.lengthBucket << "-" << (b + 1) * summary.lengthBucket - 1
+               << " " << s.lengthHistogram[b];
+        }
+        os << "\n";
+
+        if (!s.movesAlive.empty())
+            os << "  move      alive   mean score   mean empty   geo-mean max tile\n";
+        for (std::size_t k = 0; k < s.movesAlive.size(); ++k) {
+            const double alive = double(s.movesAlive[k]);
+            os << "  " << std::setw(6) << (k + 1) * summary.moveStep
+               << std::setw(11) << s.movesAlive[k]
+               << std::setw(13) << s.movesScoreSum[k] / alive
+               << std::setw(13) << s.movesEmptySum[k] / alive
+               << std::setw(20) << std::exp2(s.movesMaxExponentSum[k] / alive) << "\n";
+        }
+    }
+
+    os.flags(oldFlags);
+    os.precision(oldPrecision);
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Archives of recorded games and the analytics run over them.
+//
+// An archive is a 16-byte file header followed by blocks. Each block holds
+// many games back to back: a fixed-size game header, then one sample per
+// move. Blocks are written whole, so an archive cut short by a crash loses
+// at most its last block, and the reader can hand blocks to threads
+// without parsing the games in between. Reopening an archive for recording
+// cuts such a partial block off; the reader skips damaged bytes up to the
+// next block header.
+
+struct MoveSample {
+    std::uint32_t score       = 0;   // after the move
+    std::uint8_t  direction   = 0;   // Direction enum value
+    std::uint8_t  emptyCells  = 0;   // before the next spawn
+    std::uint8_t  maxExponent = 0;
+    std::uint8_t  reserved    = 0;
+};
+static_assert(sizeof(MoveSample) == 8, "archive move samples must stay packed");
+
+struct GameRecord {
+    std::uint64_t weightsHash = 0;
+    std::uint32_t generation  = 0;
+    std::uint32_t seed        = 0;
+    bool          seeded      = false;
+    bool          gameOver    = false;   // false when the move limit ended it
+    int           size        = 4;
+    std::uint32_t score       = 0;
+    std::uint8_t  maxExponent = 0;
+    std::vector<MoveSample> moves;
+};
+
+// Appends games to an archive. record() may be called from any thread;
+// games are buffered and written a block at a time.
+class GameRecorder {
+public:
+    GameRecorder() = default;
+    ~GameRecorder();
+
+    GameRecorder(const GameRecorder&) = delete;
+    GameRecorder& operator=(const GameRecorder&) = delete;
+
+    // Appends to an existing archive, dropping a partial last block, or
+    // starts a new one.
+    bool open(const std::string& path, std::string* error = nullptr);
+    void close();
+    bool isOpen() const { return m_out.is_open(); }
+
+    // Stamped on every game recorded from now on.
+    void setGeneration(int generation) { m_generation = generation; }
+    int  generation() const { return m_generation; }
+
+    void record(const GameRecord& game);
+    void flush();
+
+private:
+    void flushLocked();
+
+    std::mutex m_mutex;
+    std::ofstream m_out;
+    std::vector<std::uint8_t> m_block;
+    std::uint32_t m_blockGames = 0;
+    std::atomic<int> m_generation{0};
+};
+
+enum class ArchiveGrouping { Generation, Weights };
+
+struct ArchiveGroupStats {
+    std::uint64_t key   = 0;   // generation or weights hash
+    long long     games = 0;
+    long long     movesTotal = 0;
+    long long     gameOverCount = 0;
+    double        scoreTotal = 0.0;
+    long long     maxTileCount[32] = {};   // games per final max exponent
+
+    std::vector<std::uint32_t> scores;        // sorted once the scan is done
+    std::vector<long long>     lengthHistogram;  // games per lengthBucket moves
+
+    // Row k covers move (k + 1) * moveStep: games still running at that
+    // move, and sums over them.
+    std::vector<long long> movesAlive;
+    std::vector<double>    movesScoreSum;
+    std::vector<double>    movesEmptySum;
+    std::vector<double>    movesMaxExponentSum;
+
+    double scorePercentile(double p) const;
+};
+
+struct ArchiveSummary {
+    long long games = 0;
+    long long skippedBytes = 0;      // truncated or unreadable blocks
+    int       lengthBucket = 100;
+    int       moveStep = 100;
+    double    elapsedMs = 0.0;
+    std::vector<ArchiveGroupStats> groups;   // ascending by key
+};
+
+// Maps the archives and scans their blocks on every core (threadCount 0).
+// Game lengths are histogrammed in lengthBucket-move buckets and per-move
+// statistics kept every moveStep moves.
+bool analyzeArchives(const std::vector<std::string>& paths,
+                     ArchiveGrouping grouping,
+                     ArchiveSummary& out,
+                     int threadCount = 0,
+                     int lengthBucket = 100,
+                     int moveStep = 100,
+                     std::string* error = nullptr);
+
+void printArchiveReport(const ArchiveSummary& summary, ArchiveGrouping grouping,
+                        std::ostream& os);
@@ -0,0 +1,155 @@
+#include "genometable2048.h"
+#include "trace2048.h"
+
+#include <algorithm>
+#include <future>
+#include <numeric>
+#include <thread>
+
+GenomeTable::GenomeTable(const Population& pop)
+{
+    resize(pop.size());
+    for (std::size_t i = 0; i < pop.size(); ++i) {
+        setWeights(i, pop[i].w);
+        fitness[i]   = pop[i].fitness;
+        bestScore[i] = pop[i].bestScore;
+        bestMoves[i] = pop[i].bestMoves;
+    }
+}
+
+void GenomeTable::resize(std::size_t size)
+{
+    for (auto& column : genes) column.resize(size);
+    fitness.resize(size, 0.0);
+    bestScore.resize(size, 0.0);
+    bestMoves.resize(size, 0);
+}
+
+Weights GenomeTable::weights(std::size_t i) const
+{
+    Weights w;
+    for (int f = 0; f < GeneCount; ++f) w[f] = genes[f][i];
+    return w;
+}
+
+void GenomeTable::setWeights(std::size_t i, const Weights& w)
+{
+    for (int f = 0; f < GeneCount; ++f) genes[f][i] = w[f];
+}
+
+Population GenomeTable::toPopulation() const
+{
+    Population pop(size());
+    for (std::size_t i = 0; i < pop.size(); ++i) {
+        pop[i].w         = weights(i);
+        pop[i].fitness   = fitness[i];
+        pop[i].bestScore = bestScore[i];
+        pop[i].bestMoves = bestMoves[i];
+    }
+    return pop;
+}
+
+namespace {
+
+// splitmix64: cheap to seed, so every child gets a stream of its own.
+class ChildRng {
+public:
+    ChildRng(std::uint64_t seed, std::uint64_t child)
+        : m_state(seed ^ (child * 0xd1b54a32d192ed03ULL)) {}
+
+    std::uint64_t next() {
+        std::uint64_t z = (m_state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    double uniform(double a, double b) {
+        return a + (b - a) * (double(next() >> 11) * 0x1.0p-53);
+    }
+
+    std::size_t below(std::size_t n) {
+        return std::size_t(next() % n);
+    }
+
+private:
+    std::uint64_t m_state;
+};
+
+} // namespace
+
+std::size_t evolveTable(const GenomeTable& pop, GenomeTable& out,
+                        double eliteRate, double mutationRate,
+                        std::uint64_t seed, int threadCount,
+                        std::size_t outSize)
+{
+    TRACE_SCOPE("evolveTable");
+    const std::size_t size = pop.size();
+    if (outSize == 0) outSize = size;
+    out.resize(size == 0 ? 0 : outSize);
+    if (size == 0) return 0;
+
+    const std::size_t eliteCount = std::min({size, outSize,
+        std::max<std::size_t>(1, std::size_t(double(size) * eliteRate))});
+
+    // Only the elites need ordering; ties go to the lower index so the
+    // result is deterministic.
+    std::vector<std::size_t> order(size);
+    std::iota(order.begin(), order.end(), std::size_t(0));
+    auto fitter = [&](std::size_t a, std::size_t b) {
+        return pop.fitness[a] > pop.fitness[b] || (pop.fitness[a] == pop.fitness[b] && a < b);
+    };
+    std::nth_element(order.begin(), order.begin() + (eliteCount - 1), order.end(), fitter);
+    std::sort(order.begin(), order.begin() + eliteCount, fitter);
+    const std::size_t best = order[0];
+
+    for (std::size_t e = 0; e < eliteCount; ++e) {
+        const std::size_t src = order[e];
+        for (int f = 0; f < GeneCount; ++f) out.genes[f][e] = pop.genes[f][src];
+        out.fitness[e]   = pop.fitness[src];
+        out.bestScore[e] = pop.bestScore[src];
+        out.bestMoves[e] = pop.bestMoves[src];
+    }
+
+    auto breed = [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            ChildRng rng(seed, i);
+            auto pickParent = [&]() {
+                if (size == 1 || rng.uniform(0, 1) < 0.5) return best;
+                const std::size_t other = rng.below(size - 1);
+                return other >= best ? other + 1 : other;
+            };
+            const std::size_t p1 = pickParent();
+            const std::size_t p2 = pickParent();
+
+            for (int f = 0; f < GeneCount; ++f) {
+                double g = (rng.uniform(0, 1) < 0.5) ? pop.genes[f][p1] : pop.genes[f][p2];
+                const double step = Genes[f].mutationStep;
+                if (rng.uniform(0, 1) < mutationRate) g += rng.uniform(-step, step);
+                out.genes[f][i] = g;
+            }
+            out.fitness[i]   = 0.0;
+            out.bestScore[i] = 0.0;
+            out.bestMoves[i] = 0;
+        }
+    };
+
+    // Small batches are not worth a thread.
+    constexpr std::size_t kMinChildrenPerTask = 2048;
+    const std::size_t children = outSize - eliteCount;
+    const std::size_t workers = (threadCount > 0)
+        ? std::size_t(threadCount)
+        : std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t tasks = std::max<std::size_t>(1,
+        std::min(workers, children / kMinChildrenPerTask));
+
+    std::vector<std::future<void>> futures;
+    for (std::size_t t = 1; t < tasks; ++t) {
+        const std::size_t begin = eliteCount + children * t / tasks;
+        const std::size_t end   = eliteCount + children * (t + 1) / tasks;
+        futures.emplace_back(std::async(std::launch::async, breed, begin, end));
+    }
+    breed(eliteCount, eliteCount + children / tasks);
+    for (auto& f : futures) f.get();
+    return eliteCount;
+}
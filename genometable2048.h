@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ai2048.h"
+
+// A population stored column-wise: one array per gene and one per result.
+// Selection only scans the fitness column, and children bred on different
+// threads write to disjoint slices of each column.
+class GenomeTable {
+public:
+    GenomeTable() = default;
+    explicit GenomeTable(std::size_t size) { resize(size); }
+    explicit GenomeTable(const Population& pop);
+
+    std::size_t size() const { return fitness.size(); }
+    void resize(std::size_t size);
+
+    Weights weights(std::size_t i) const;
+    void    setWeights(std::size_t i, const Weights& w);
+    Population toPopulation() const;
+
+    std::vector<double> genes[GeneCount];
+    std::vector<double> fitness;
+    std::vector<double> bestScore;
+    std::vector<int>    bestMoves;
+};
+
+// Breeds the next generation into out, with the same scheme as evolve():
+// the top eliteRate fraction is kept in fitness order, and each child
+// crosses two parents that are each the best individual half the time and
+// a uniformly drawn other one otherwise.
+//
+// Elites are found by partial selection rather than a full sort. Children
+// are bred in parallel, each from its own random stream derived from seed,
+// so the result depends on seed but not on threadCount (0 = all cores).
+//
+// out gets outSize rows (0 = pop.size()); a larger table breeds extra
+// children for a caller that screens them. Returns the number of elites,
+// which are always the first rows.
+std::size_t evolveTable(const GenomeTable& pop, GenomeTable& out,
+                        double eliteRate, double mutationRate,
+                        std::uint64_t seed, int threadCount = 0,
+                        std::size_t outSize = 0);
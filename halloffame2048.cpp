@@ -0,0 +1,252 @@
+#include "halloffame2048.h"
+#include "affinity2048.h"
+#include "checkpoint2048.h"
+#include "trace2048.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <future>
+#include <numeric>
+#include <sstream>
+#include <thread>
+
+double BenchmarkResult::mean() const
+{
+    if (scores.empty()) return 0.0;
+    return std::accumulate(scores.begin(), scores.end(), 0.0) / double(scores.size());
+}
+
+double BenchmarkResult::best() const
+{
+    return scores.empty() ? 0.0 : *std::max_element(scores.begin(), scores.end());
+}
+
+std::vector<BenchmarkResult> playBenchmark(const std::vector<Weights>& players,
+                                           const BenchmarkSpec& spec,
+                                           int threadCount)
+{
+    TRACE_SCOPE("playBenchmark");
+    using Clock = std::chrono::steady_clock;
+
+    const std::size_t games = std::size_t(std::max(0, spec.games));
+    const std::size_t total = players.size() * games;
+    std::vector<double> scores(total, 0.0);
+    std::vector<int>    moves(total, 0);
+    std::vector<double> seconds(total, 0.0);
+
+    // Threads take the next game off a shared counter; every result lands
+    // in its own slot, so the sums below do not depend on who played what.
+    std::atomic<std::size_t> next{0};
+    auto worker = [&]() {
+        pinSimulationThread();
+        for (std::size_t job; (job = next.fetch_add(1)) < total; ) {
+            const Weights& w = players[job / games];
+            const std::uint32_t seed = spec.seedBase + std::uint32_t(job % games);
+            const Clock::time_point start = Clock::now();
+            scores[job]  = playSeededGame(w, seed, spec.maxMoves, &moves[job]);
+            seconds[job] = std::chrono::duration<double>(Clock::now() - start).count();
+        }
+    };
+
+    const int threads = (threadCount > 0)
+        ? threadCount
+        : int(std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::future<void>> futures;
+    for (int t = 1; t < threads && std::size_t(t) < total; ++t)
+        futures.emplace_back(std::async(std::launch::async, worker));
+    worker();
+    for (auto& f : futures) f.get();
+
+    std::vector<BenchmarkResult> results(players.size());
+    for (std::size_t p = 0; p < players.size(); ++p) {
+        BenchmarkResult& r = results[p];
+        r.scores.assign(scores.begin() + p * games, scores.begin() + (p + 1) * games);
+        long long moveCount = 0;
+        double time = 0.0;
+        for (std::size_t g = p * games; g < (p + 1) * games; ++g) {
+            moveCount += moves[g];
+            time += seconds[g];
+        }
+        r.msPerMove = moveCount > 0 ? time * 1000.0 / double(moveCount) : 0.0;
+    }
+    return results;
+}
+
+HeadToHead compareHeadToHead(const BenchmarkResult& a, const BenchmarkResult& b)
+{
+    HeadToHead h;
+    const std::size_t n = std::min(a.scores.size(), b.scores.size());
+    if (n == 0) return h;
+
+    double sum = 0.0, sumSq = 0.0;
+    for (std::size_t i = 0; i < n; ++i) {
+        const double d = a.scores[i] - b.scores[i];
+        sum += d;
+        sumSq += d * d;
+        if (d > 0) ++h.wins;
+        else if (d < 0) ++h.losses;
+        else ++h.ties;
+    }
+    h.meanDiff = sum / double(n);
+    if (n > 1) {
+        const double variance = (sumSq - sum * h.meanDiff) / double(n - 1);
+        h.stdErr = std::sqrt(std::max(0.0, variance) / double(n));
+    }
+    return h;
+}
+
+const HallOfFame::Member* HallOfFame::find(const Weights& w) const
+{
+    const std::uint64_t h = hashWeights(w);
+    for (const Member& m : m_members)
+        if (hashWeights(m.w) == h && sameWeights(m.w, w)) return &m;
+    return nullptr;
+}
+
+bool HallOfFame::add(const Weights& w, int generation, double fitness,
+                     const BenchmarkResult* result)
+{
+    if (find(w)) return false;
+
+    Member m;
+    m.w          = w;
+    m.generation = generation;
+    m.fitness    = fitness;
+    if (result) {
+        m.benchmarked = true;
+        m.result      = *result;
+    }
+    m_members.push_back(std::move(m));
+    return true;
+}
+
+int HallOfFame::benchmark(const BenchmarkSpec& spec, int threadCount)
+{
+    TRACE_SCOPE("HallOfFame::benchmark");
+    if (!(spec == m_spec)) {
+        for (Member& m : m_members) {
+            m.benchmarked = false;
+            m.result = BenchmarkResult();
+        }
+        m_spec = spec;
+    }
+
+    std::vector<std::size_t> todo;
+    std::vector<Weights> players;
+    for (std::size_t i = 0; i < m_members.size(); ++i) {
+        if (m_members[i].benchmarked) continue;
+        todo.push_back(i);
+        players.push_back(m_members[i].w);
+    }
+    if (todo.empty()) return 0;
+
+    std::vector<BenchmarkResult> results = playBenchmark(players, m_spec, threadCount);
+    for (std::size_t k = 0; k < todo.size(); ++k) {
+        m_members[todo[k]].benchmarked = true;
+        m_members[todo[k]].result = std::move(results[k]);
+    }
+    return int(todo.size());
+}
+
+void HallOfFame::prune(std::size_t capacity)
+{
+    std::stable_sort(m_members.begin(), m_members.end(), [](const Member& a, const Member& b) {
+        if (a.benchmarked != b.benchmarked) return a.benchmarked;
+        return a.result.mean() > b.result.mean();
+    });
+    if (m_members.size() > capacity) m_members.resize(capacity);
+}
+
+void HallOfFame::pruneByFitness(std::size_t capacity)
+{
+    if (m_members.size() <= capacity) return;
+    std::stable_sort(m_members.begin(), m_members.end(), [](const Member& a, const Member& b) {
+        return a.fitness > b.fitness;
+    });
+    m_members.resize(capacity);
+}
+
+// "halloffame 2", the benchmark spec, the member count, a "genes" line,
+// then one line per member: generation, fitness, the genes as that line
+// names them, and - if benchmarked - ms/move and the per-seed scores after
+// a '|'. Version 1 had no "genes" line and listed genes in genome order.
+bool HallOfFame::save(const std::string& path, std::string* error) const
+{
+    std::ostringstream os;
+    os.precision(17);
+    os << "halloffame 2\n"
+       << m_spec.seedBase << ' ' << m_spec.games << ' ' << m_spec.maxMoves << '\n'
+       << m_members.size() << '\n';
+    writeGeneHeader(os);
+    for (const Member& m : m_members) {
+        os << m.generation << ' ' << m.fitness;
+        for (int i = 0; i < GeneCount; ++i) os << ' ' << m.w[i];
+        if (m.benchmarked) {
+            os << " | " << m.result.msPerMove;
+            for (double s : m.result.scores) os << ' ' << s;
+        }
+        os << '\n';
+    }
+    return writeFileAtomically(path, os.str(), error);
+}
+
+bool HallOfFame::load(const std::string& path, std::string* error)
+{
+    m_members.clear();
+    m_spec = BenchmarkSpec();
+
+    std::ifstream ifs(path);
+    if (!ifs.is_open()) return true;
+
+    std::string magic;
+    int version = 0;
+    std::size_t count = 0;
+    std::vector<int> columns;
+    std::string line;
+    if (!(ifs >> magic >> version) || magic != "halloffame" || version < 1 || version > 2
+        || !(ifs >> m_spec.seedBase >> m_spec.games >> m_spec.maxMoves >> count)
+        || (version >= 2 && !(std::getline(ifs >> std::ws, line)
+                              && readGeneHeader(line, columns)))) {
+        if (error) *error = path + " is not a hall of fame file";
+        return false;
+    }
+    if (version == 1) {
+        columns.resize(GeneCount);
+        std::iota(columns.begin(), columns.end(), 0);
+    }
+
+    for (std::size_t k = 0; k < count; ++k) {
+        if (!std::getline(ifs >> std::ws, line)) {
+            if (error) *error = path + " is truncated";
+            return false;
+        }
+
+        Member m;
+        const auto bar = line.find('|');
+        std::istringstream ls(line.substr(0, bar));
+        bool ok = bool(ls >> m.generation >> m.fitness);
+        for (std::size_t c = 0; c < columns.size() && ok; ++c) {
+            double v = 0.0;
+            ok = bool(ls >> v);
+            if (ok && columns[c] >= 0) m.w[columns[c]] = v;
+        }
+        std::string extra;
+        ok = ok && !(ls >> extra);
+        if (ok && bar != std::string::npos) {
+            std::istringstream rs(line.substr(bar + 1));
+            ok = bool(rs >> m.result.msPerMove);
+            for (double s; ok && rs >> s; ) m.result.scores.push_back(s);
+            m.benchmarked = ok && (int)m.result.scores.size() == m_spec.games;
+            if (!m.benchmarked) m.result = BenchmarkResult();
+        }
+        if (!ok) {
+            if (error) *error = path + ": bad member line " + std::to_string(k + 1);
+            return false;
+        }
+        m_members.push_back(std::move(m));
+    }
+    return true;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ai2048.h"
+
+// Champions kept across generations, with a fixed-seed benchmark to tell
+// whether a newly trained agent is actually better than the old ones.
+//
+// Training fitness is noisy and only comparable within one generation.
+// The benchmark plays every player over the same seeds instead, so two
+// players can be compared game by game. Archived members keep their
+// per-seed scores in the hall-of-fame file and are only replayed when the
+// benchmark settings change.
+
+struct BenchmarkSpec {
+    std::uint32_t seedBase = 3000000000u;   // well clear of training seeds
+    int           games    = 1000;
+    int           maxMoves = 5000;
+
+    bool operator==(const BenchmarkSpec& o) const {
+        return seedBase == o.seedBase && games == o.games && maxMoves == o.maxMoves;
+    }
+};
+
+struct BenchmarkResult {
+    std::vector<double> scores;   // game i was played with seed seedBase + i
+    double msPerMove = 0.0;
+
+    double mean() const;
+    double best() const;
+};
+
+// Plays every player over spec's seeds. All games go into one pool shared
+// by threadCount threads (0 = all cores), so a few players still keep every
+// core busy; results do not depend on the thread count.
+std::vector<BenchmarkResult> playBenchmark(const std::vector<Weights>& players,
+                                           const BenchmarkSpec& spec,
+                                           int threadCount = 0);
+
+// Paired comparison of a against b over the seeds both played.
+struct HeadToHead {
+    double meanDiff = 0.0;   // mean of a - b
+    double stdErr   = 0.0;   // of meanDiff
+    int    wins = 0, losses = 0, ties = 0;
+};
+
+HeadToHead compareHeadToHead(const BenchmarkResult& a, const BenchmarkResult& b);
+
+class HallOfFame {
+public:
+    struct Member {
+        Weights w;
+        int     generation = 0;
+        double  fitness    = 0.0;   // training fitness when it was added
+        bool    benchmarked = false;
+        BenchmarkResult result;     // for spec(), when benchmarked
+    };
+
+    // A missing file is an empty hall of fame, not an error.
+    bool load(const std::string& path, std::string* error = nullptr);
+    bool save(const std::string& path, std::string* error = nullptr) const;
+
+    // False if these weights are already a member. A result, if given,
+    // must be for spec().
+    bool add(const Weights& w, int generation, double fitness,
+             const BenchmarkResult* result = nullptr);
+
+    const Member* find(const Weights& w) const;
+    const std::vector<Member>& members() const { return m_members; }
+    const BenchmarkSpec& spec() const { return m_spec; }
+
+    // Switches to spec, forgetting results of any other spec, and plays
+    // the members that have none. Returns how many were played.
+    int benchmark(const BenchmarkSpec& spec, int threadCount = 0);
+
+    // Keeps the capacity members with the best benchmark means; members
+    // without results are dropped first.
+    void prune(std::size_t capacity);
+    // Keeps the capacity members with the best training fitness. Fitness
+    // is noisy, so this only bounds the archive while training; prune()
+    // decides once members have been benchmarked.
+    void pruneByFitness(std::size_t capacity);
+
+private:
+    BenchmarkSpec m_spec;
+    std::vector<Member> m_members;
+};
@@ -1,8 +1,381 @@
 #include <QApplication>
 #include "mainwindow.h"
+#include "tablebase2048.h"
+#include "affinity2048.h"
+#include "batcheval2048.h"
+#include "evalcheck2048.h"
+#include "gamearchive2048.h"
+#include "halloffame2048.h"
+#include "surrogate2048.h"
+#include "sweep2048.h"
+#include "trace2048.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+static const char* const HallOfFameFile = "hall_of_fame.txt";
+static const std::size_t HallOfFameCapacity = 64;
+
+static int argInt(int argc, char* argv[], int index, int fallback)
+{
+    return (index < argc) ? std::atoi(argv[index]) : fallback;
+}
+
+#ifdef Q_OS_UNIX
+#include "checkpoint2048.h"
+#include "distfitness.h"
+#include "moveservice.h"
+#include <csignal>
+
+
+// Headless training: evaluates each generation on the connected workers,
+// then evolves and saves exactly like the GA window does.
+static int runTrainer(const std::string& endpoint, int generations, int games, int maxMoves,
+                      int populationSize)
+{
+    const char* saveFile = "population_state.txt";
+
+    FitnessMaster master(endpoint);
+    std::string error;
+    if (!master.start(&error)) {
+        std::cerr << "trainer: " << error << std::endl;
+        return 1;
+    }
+
+    // GAME2048_COST=budget:<ms per move> or pareto makes compute count.
+    CostModel cost;
+    const char* costSpec = std::getenv("GAME2048_COST");
+    if (costSpec && !parseCostModel(costSpec, cost)) {
+        std::cerr << "trainer: bad GAME2048_COST '" << costSpec << "'" << std::endl;
+        return 1;
+    }
+
+    int generation = 0;
+    Population pop = loadPopulation(saveFile, populationSize, generation);
+    populationSize = std::max(1, populationSize);
+    if ((int)pop.size() < populationSize) {
+        Population extra = createInitialPopulation(populationSize - (int)pop.size());
+        pop.insert(pop.end(), extra.begin(), extra.end());
+    } else if ((int)pop.size() > populationSize) {
+        std::nth_element(pop.begin(), pop.begin() + populationSize, pop.end(),
+            [](const Individual& x, const Individual& y) { return x.fitness > y.fitness; });
+        pop.resize(populationSize);
+    }
+
+    // GAME2048_CHECKPOINT_MS=<ms> saves at most that often; the last
+    // generation is always saved.
+    const char* checkpointMs = std::getenv("GAME2048_CHECKPOINT_MS");
+    Checkpointer checkpoints(saveFile, checkpointMs ? std::atoi(checkpointMs) : 0);
+
+    // GAME2048_SCREEN=<n> breeds n children per slot and only evaluates
+    // the ones a surrogate fitted to all earlier results rates highest.
+    const char* screenSpec = std::getenv("GAME2048_SCREEN");
+    const int oversample = screenSpec ? std::max(1, std::atoi(screenSpec)) : 1;
+    FitnessSurrogate surrogate;
+
+    // Elites and duplicate children reuse their earlier games and play a
+    // few more each generation, so a lucky first evaluation fades out.
+    FitnessCache fitnessCache;
+    const int topUpGames = std::max(1, games / 5);
+
+    // Every generation's champion goes into the hall of fame, to be
+    // benchmarked later with --benchmark.
+    HallOfFame hallOfFame;
+    if (!hallOfFame.load(HallOfFameFile, &error)) {
+        std::cerr << "trainer: " << error << std::endl;
+        return 1;
+    }
+
+    for (int i = 0; i < generations; ++i) {
+        // Every individual of a generation plays the same seeds.
+        const std::uint32_t seedBase = std::uint32_t(generation) * 1000003u;
+        if (!evaluatePopulationDistributed(pop, games, maxMoves, seedBase, master, generation,
+                                           &fitnessCache, topUpGames)) {
+            std::cerr << "trainer: no workers available" << std::endl;
+            return 1;
+        }
+        // The surrogate learns raw scores; the cost model is applied to its
+        // predictions.
+        if (oversample > 1) surrogate.observe(pop);
+        applyCostModel(pop, cost);
+
+        auto best = std::max_element(pop.begin(), pop.end(),
+            [](const Individual& x, const Individual& y) { return x.fitness < y.fitness; });
+        std::cout << "Generation " << generation
+                  << " best fitness = " << best->fitness
+                  << " (score=" << best->bestScore
+                  << ", steps=" << best->bestMoves
+                  << ", depth=" << searchDepthOf(best->w)
+                  << ", ms/move=" << best->msPerMove << ", workers="
+                  << master.workerCount() << ")" << std::endl;
+        // Saved as it grows, so a killed trainer keeps its champions, and
+        // capped so the file and the next --benchmark stay bounded.
+        if (hallOfFame.add(best->w, generation, best->fitness)) {
+            hallOfFame.pruneByFitness(HallOfFameCapacity);
+            if (!hallOfFame.save(HallOfFameFile, &error))
+                std::cerr << "trainer: " << error << std::endl;
+        }
+
+        if (oversample > 1) {
+            int screened = 0;
+            pop = evolveScreened(pop, surrogate, cost, 0.1, 0.1, oversample, &screened);
+            if (screened > 0)
+                std::cout << "  screened out " << screened << " children" << std::endl;
+        } else {
+            pop = evolve(pop, 0.1, 0.1);
+        }
+        fitnessCache.retain(pop);
+        ++generation;
+        checkpoints.submit(pop, generation);
+    }
+
+    master.shutdownWorkers();
+    if (!hallOfFame.save(HallOfFameFile, &error) || !checkpoints.flush(&error)) {
+        std::cerr << "trainer: " << error << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+static int runWorker(const std::string& endpoint, int threadCount, const char* archive)
+{
+    GameRecorder recorder;
+    std::string error;
+    if (archive && !recorder.open(archive, &error)) {
+        std::cerr << "worker: " << error << std::endl;
+        return 1;
+    }
+    return runFitnessWorker(endpoint, threadCount, archive ? &recorder : nullptr);
+}
+
+static MoveService* s_service = nullptr;
+
+static int runMoveService(const std::string& endpoint, const std::string& populationFile,
+                          int threadCount)
+{
+    Weights w;
+    std::string error;
+    if (!loadBestWeights(populationFile, w, &error)) {
+        std::cerr << "serve: " << error << std::endl;
+        return 1;
+    }
+
+    MoveServiceOptions opt;
+    opt.threadCount = std::max(1, threadCount);
+    MoveService service(w, opt);
+    if (!service.start(endpoint, &error)) {
+        std::cerr << "serve: " << error << std::endl;
+        return 1;
+    }
+
+    s_service = &service;
+    auto onSignal = [](int) { s_service->stop(); };
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    service.run();
+    s_service = nullptr;
+
+    const MoveServiceStats stats = service.stats();
+    std::cout << "move service: served " << stats.requests << " requests in "
+              << stats.batches << " batches" << std::endl;
+    return 0;
+}
+#endif
+
+// game-2048 --analyze [--by-weights] <archive>...
+static int runArchiveAnalysis(int argc, char* argv[])
+{
+    ArchiveGrouping grouping = ArchiveGrouping::Generation;
+    std::vector<std::string> paths;
+    for (int i = 2; i < argc; ++i) {
+        if (std::string(argv[i]) == "--by-weights") grouping = ArchiveGrouping::Weights;
+        else paths.push_back(argv[i]);
+    }
+
+    ArchiveSummary summary;
+    std::string error;
+    if (paths.empty() || !analyzeArchives(paths, grouping, summary, 0, 100, 100, &error)) {
+        std::cerr << "analyze: " << (paths.empty() ? "no archives given" : error) << std::endl;
+        return 1;
+    }
+    printArchiveReport(summary, grouping, std::cout);
+    return 0;
+}
+
+// game-2048 --benchmark [population] [games] [maxMoves]
+//
+// Plays the population's fittest individual and every hall-of-fame member
+// that has no cached result over the same seeds, prints the ranking and
+// compares the challenger with the best archived member game by game.
+// Exits with 2 if the challenger is significantly worse, so scripts can
+// use it as a gate before promoting an agent.
+static int runBenchmark(int argc, char* argv[])
+{
+    const std::string populationFile = argc >= 3 ? argv[2] : "population_state.txt";
+    BenchmarkSpec spec;
+    spec.games    = std::max(1, argInt(argc, argv, 3, spec.games));
+    spec.maxMoves = std::max(1, argInt(argc, argv, 4, spec.maxMoves));
+
+    int generation = 0;
+    const Population pop = loadPopulation(populationFile, 0, generation);
+    HallOfFame hallOfFame;
+    std::string error;
+    if (pop.empty() || !hallOfFame.load(HallOfFameFile, &error)) {
+        std::cerr << "benchmark: "
+                  << (pop.empty() ? "cannot read " + populationFile : error) << std::endl;
+        return 1;
+    }
+    const Individual& challenger = *std::max_element(pop.begin(), pop.end(),
+        [](const Individual& x, const Individual& y) { return x.fitness < y.fitness; });
+
+    const int played = hallOfFame.benchmark(spec);
+    const HallOfFame::Member* archived = hallOfFame.find(challenger.w);
+    BenchmarkResult result = archived ? archived->result
+                                      : playBenchmark({challenger.w}, spec).front();
+    std::cout << "Played " << played + (archived ? 0 : 1) << " players over "
+              << spec.games << " seeds; reused " << hallOfFame.members().size() - played
+              << " cached results" << std::endl;
+
+    // The best member before the challenger joins.
+    const HallOfFame::Member* champion = nullptr;
+    for (const auto& m : hallOfFame.members()) {
+        if (&m == archived) continue;
+        if (!champion || m.result.mean() > champion->result.mean()) champion = &m;
+    }
+
+    std::vector<const HallOfFame::Member*> ranking;
+    for (const auto& m : hallOfFame.members()) ranking.push_back(&m);
+    std::sort(ranking.begin(), ranking.end(), [](auto* a, auto* b) {
+        return a->result.mean() > b->result.mean();
+    });
+    std::printf("%4s %10s %10s %8s %9s\n", "rank", "generation", "mean", "best", "ms/move");
+    for (std::size_t i = 0; i < ranking.size(); ++i) {
+        std::printf("%4zu %10d %10.1f %8.0f %9.4f\n", i + 1, ranking[i]->generation,
+                    ranking[i]->result.mean(), ranking[i]->result.best(),
+                    ranking[i]->result.msPerMove);
+    }
+    std::printf("challenger (generation %d): mean %.1f, best %.0f, %.4f ms/move\n",
+                generation, result.mean(), result.best(), result.msPerMove);
+
+    int exitCode = 0;
+    if (champion) {
+        const HeadToHead h = compareHeadToHead(result, champion->result);
+        const bool regression = h.meanDiff < -2.0 * h.stdErr;
+        std::printf("vs generation %d: %+.1f +/- %.1f per game, %d wins / %d losses / %d ties%s\n",
+                    champion->generation, h.meanDiff, h.stdErr, h.wins, h.losses, h.ties,
+                    regression ? " - REGRESSION" : "");
+        if (regression) exitCode = 2;
+    }
+
+    hallOfFame.add(challenger.w, generation, challenger.fitness, &result);
+    hallOfFame.prune(HallOfFameCapacity);
+    if (!hallOfFame.save(HallOfFameFile, &error)) {
+        std::cerr << "benchmark: " << error << std::endl;
+        return 1;
+    }
+    return exitCode;
+}
+
+// game-2048 --sweep <spec> [generations] [threads] [csv]
+//
+// Trains one GA run per configuration of spec (see parseSweepSpec) on a
+// shared thread pool and writes a summary, best run first.
+static int runSweepCommand(int argc, char* argv[])
+{
+    std::vector<SweepConfig> configs;
+    std::string error;
+    if (!parseSweepSpec(argv[2], configs, &error)) {
+        std::cerr << "sweep: " << error << std::endl;
+        return 1;
+    }
+
+    SweepOptions options;
+    options.generations = std::max(1, argInt(argc, argv, 3, options.generations));
+    options.threadCount = argInt(argc, argv, 4, 0);
+    const std::string csvFile = argc >= 6 ? argv[5] : "sweep.csv";
+
+    std::cout << "Sweeping " << configs.size() << " configurations" << std::endl;
+    const std::vector<SweepResult> results = runSweep(configs, options, [](const SweepResult& r) {
+        std::printf("population %3d  elite %.3f  mutation %.3f  games %2d  maxMoves %5d: "
+                    "%-8s after %2d generations, benchmark %.1f, %.1f cpu s\n",
+                    r.config.populationSize, r.config.eliteRate, r.config.mutationRate,
+                    r.config.games, r.config.maxMoves, sweepStatusName(r.status),
+                    r.generations, r.bestBenchmark, r.cpuSeconds);
+        std::fflush(stdout);
+    });
+
+    if (!writeSweepCsv(csvFile, results, &error)) {
+        std::cerr << "sweep: " << error << std::endl;
+        return 1;
+    }
+    std::cout << "Summary written to " << csvFile << std::endl;
+    return 0;
+}
+
+// Offline generation: game-2048 --build-tablebase <size> <goalTile> <file>
+static int runTablebaseBuilder(int size, int goalTile, const std::string& path)
+{
+    int goalExponent = 0;
+    while ((1 << goalExponent) < goalTile) ++goalExponent;
+
+    std::string error;
+    if (!buildTablebase(size, goalExponent, path, &error)) {
+        std::fprintf(stderr, "tablebase: %s\n", error.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+// game-2048 --check-eval [boards per size]
+static int runEvalCheck(int boards)
+{
+    std::string error;
+    if (!checkPackedEvaluators(boards, 1, &error)) {
+        std::fprintf(stderr, "check-eval: %s\n", error.c_str());
+        return 1;
+    }
+    std::printf("packed evaluators (%s) match evaluateBoard on %d boards per size\n",
+                evaluateBoardsKernel(), boards);
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
+    // Builds with CONFIG+=trace write a Chrome trace of the whole run here.
+    TraceSession trace(std::getenv("GAME2048_TRACE"));
+    // GAME2048_CPUS=0-15 or GAME2048_NUMA_NODE=1 pins simulation threads.
+    configureSimulationCpusFromEnvironment();
+
+    if (argc >= 5 && std::string(argv[1]) == "--build-tablebase")
+        return runTablebaseBuilder(std::atoi(argv[2]), std::atoi(argv[3]), argv[4]);
+    if (argc >= 2 && std::string(argv[1]) == "--analyze")
+        return runArchiveAnalysis(argc, argv);
+    if (argc >= 2 && std::string(argv[1]) == "--benchmark")
+        return runBenchmark(argc, argv);
+    if (argc >= 3 && std::string(argv[1]) == "--sweep")
+        return runSweepCommand(argc, argv);
+    if (argc >= 2 && std::string(argv[1]) == "--check-eval")
+        return runEvalCheck(argInt(argc, argv, 2, 10000));
+
+#ifdef Q_OS_UNIX
+    // game-2048 --worker <endpoint> [threads] [archive]
+    // game-2048 --train <endpoint> [generations] [games] [maxMoves] [population]
+    // game-2048 --serve <endpoint> [populationFile] [threads]
+    // Endpoints are unix:/path or host:port.
+    if (argc >= 3 && std::string(argv[1]) == "--worker")
+        return runWorker(argv[2], argInt(argc, argv, 3, 0), argc >= 5 ? argv[4] : nullptr);
+    if (argc >= 3 && std::string(argv[1]) == "--train")
+        return runTrainer(argv[2], argInt(argc, argv, 3, 100),
+                          argInt(argc, argv, 4, 10), argInt(argc, argv, 5, 1000),
+                          argInt(argc, argv, 6, 40));
+    if (argc >= 3 && std::string(argv[1]) == "--serve")
+        return runMoveService(argv[2], argc >= 4 ? argv[3] : "population_state.txt",
+                              argInt(argc, argv, 4, 1));
+#endif
+
     QApplication app(argc, argv);
 
     MainWindow w;
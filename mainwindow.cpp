@@ -1,5 +1,7 @@
 #include "mainwindow.h"
 #include "ai2048.h"
+#include "search2048.h"
+#include "ponder2048.h"
 #include "populationwindow.h"
 #include "boardwidget.h"
 #include "game2048.h"
@@ -9,6 +11,7 @@
 #include <QPushButton>
 #include <QKeyEvent>
 #include <QMessageBox>
+#include <QStatusBar>
 
 MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent)
@@ -69,6 +72,22 @@ MainWindow::MainWindow(QWidget* parent)
     setWindowTitle("2048 Qt");
     resize(520, 600);
 
+    SearchOptions ponder;
+    ponder.deadlineMs = PonderDeadlineMs;
+    ponder.threadCount = 0;
+    ponder.minProbability = 1e-4;
+    ponder.maxSpawnCells  = 6;
+    ponder.fourSpawnPlies = 1;
+    SearchOptions reply = ponder;
+    reply.deadlineMs = PonderReplyMs;
+    m_ponderer = std::make_unique<Ponderer>(Weights(), ponder, reply);
+    m_ponderer->setOnReady([this](const PonderResult& r) {
+        const int depth = r.stats.depthReached;
+        QMetaObject::invokeMethod(this, [this, depth] {
+            statusBar()->showMessage(QString("AI: hint ready (depth %1)").arg(depth));
+        }, Qt::QueuedConnection);
+    });
+
     connect(m_resetBtn, &QPushButton::clicked, this, [this] {
         m_game->reset();
         m_winShown = false;
@@ -79,12 +98,15 @@ MainWindow::MainWindow(QWidget* parent)
 }
 
 MainWindow::~MainWindow() {
+    // Stops the pondering thread before the window it reports to goes away.
+    m_ponderer.reset();
     delete m_game;
 }
 
 void MainWindow::refreshUI() {
     m_scoreLabel->setText("Score: " + QString::number(m_game->score()));
     m_board->update();
+    m_ponderer->setPosition(*m_game);
     showWinDialogIfNeeded();
 
     if (m_game->isGameOver()) {
@@ -125,8 +147,29 @@ void MainWindow::keyPressEvent(QKeyEvent* e) {
         moved = m_game->moveDown();
         break;
     case Qt::Key_Space: {
-        Weights w;
-        Direction d = chooseMove(*m_game, w);
+        // A pondered move is free; otherwise search now, briefly.
+        PonderResult pondered;
+        const bool ready = m_ponderer->lookup(*m_game, pondered);
+        Direction d = pondered.move;
+        SearchStats stats = pondered.stats;
+        if (!ready) {
+            Weights w;
+            SearchOptions opt;
+            opt.deadlineMs = HintDeadlineMs;
+            opt.threadCount = 0;
+            opt.minProbability = 1e-4;
+            opt.maxSpawnCells  = 6;
+            opt.fourSpawnPlies = 1;
+            d = searchMove(*m_game, w, opt, &stats);
+        }
+        statusBar()->showMessage(
+            QString("AI%6: depth %1, %2 nodes, %3 ms, %4 threads at %5% efficiency")
+                .arg(stats.depthReached)
+                .arg(stats.nodes)
+                .arg(stats.elapsedMs, 0, 'f', 1)
+                .arg(stats.threadsUsed)
+                .arg(qRound(stats.efficiency * 100))
+                .arg(ready ? " (pondered)" : ""));
         switch (d) {
         case Direction::Left:  moved = m_game->moveLeft();  break;
         case Direction::Right: moved = m_game->moveRight(); break;
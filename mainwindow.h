@@ -1,11 +1,13 @@
 #pragma once
 #include <QMainWindow>
+#include <memory>
 
 class QLabel;
 class QPushButton;
 class BoardWidget;
 class Game2048;
 class PopulationWindow;
+class Ponderer;
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -20,10 +22,17 @@ private:
     void refreshUI();
     void showWinDialogIfNeeded();
 
+    static constexpr double HintDeadlineMs = 5.0;
+    // Background search while the player thinks: the current position, then
+    // every position the next move and spawn can lead to.
+    static constexpr double PonderDeadlineMs = 250.0;
+    static constexpr double PonderReplyMs    = 25.0;
+
     Game2048* m_game = nullptr;
     BoardWidget* m_board = nullptr;
     QLabel* m_scoreLabel = nullptr;
     QPushButton* m_resetBtn = nullptr;
     bool m_winShown = false;
     PopulationWindow* m_populationWindow = nullptr;
+    std::unique_ptr<Ponderer> m_ponderer;
 };
@@ -0,0 +1,384 @@
+#include "moveservice.h"
+#include "batcheval2048.h"
+#include "netio.h"
+#include "trace2048.h"
+
+#include <poll.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iostream>
+
+namespace {
+
+enum MessageType : std::uint8_t {
+    MsgSuggest     = 1,   // client -> service: u32 count, {u64 id, u8 size, u64 board}
+    MsgSuggestions = 2,   // service -> client: u32 count, {u64 id, u8 direction, f64 score}
+    MsgStats       = 3,   // client -> service, empty
+    MsgStatsReply  = 4    // service -> client: u32 version, u64 requests, u64 batches,
+                          //                    f64 qps, f64 p50Us, f64 p99Us, f64 meanBatch
+};
+
+constexpr std::uint32_t kProtocolVersion = 1;
+constexpr int kPollIntervalMs = 100;
+constexpr std::size_t kMaxSamples = std::size_t(1) << 17;
+// A client whose unread replies pass this is dropped rather than buffered;
+// its unanswered requests are held to the same size and the rest left in
+// the socket.
+constexpr std::size_t kMaxBacklog = std::size_t(8) << 20;
+// Below this many boards a batch is scored on the serving thread alone.
+constexpr std::size_t kMinBoardsPerTask = 1024;
+
+std::int64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void suggestRange(const MoveRequest* requests, std::size_t count, const Weights& w,
+                  MoveSuggestion* out)
+{
+    std::vector<Board64> afterstates;
+    std::vector<std::uint32_t> owners;   // request index << 2 | direction
+    afterstates.reserve(count * 4);
+    owners.reserve(count * 4);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        out[i] = MoveSuggestion();
+        out[i].id = requests[i].id;
+        // Sizes a Board64 cannot hold come back as NoMove.
+        if (requests[i].size < 1 || requests[i].size > 4) continue;
+        for (int d = 0; d < 4; ++d) {
+            Board64 after;
+            if (moveBoard(requests[i].board, d, after, requests[i].size)) {
+                afterstates.push_back(after);
+                owners.push_back(std::uint32_t(i << 2) | std::uint32_t(d));
+            }
+        }
+    }
+
+    // One pass per run of equally sized boards, which in practice is one
+    // pass for the whole range.
+    std::vector<double> scores(afterstates.size());
+    for (std::size_t begin = 0; begin < afterstates.size(); ) {
+        const int n = requests[owners[begin] >> 2].size;
+        std::size_t end = begin + 1;
+        while (end < afterstates.size() && requests[owners[end] >> 2].size == n) ++end;
+        evaluateBoards(afterstates.data() + begin, end - begin, n, w, scores.data() + begin);
+        begin = end;
+    }
+
+    for (std::size_t k = 0; k < afterstates.size(); ++k) {
+        MoveSuggestion& s = out[owners[k] >> 2];
+        if (s.direction == MoveSuggestion::NoMove || scores[k] > s.score) {
+            s.direction = int(owners[k] & 3);
+            s.score     = scores[k];
+        }
+    }
+}
+
+} // namespace
+
+bool loadBestWeights(const std::string& populationFile, Weights& out, std::string* error)
+{
+    if (!std::ifstream(populationFile).is_open()) {
+        if (error) *error = "cannot read " + populationFile;
+        return false;
+    }
+
+    // An expected size of 0 turns loadPopulation()'s random fallback into
+    // an empty population.
+    int generation = 0;
+    Population pop = loadPopulation(populationFile, 0, generation);
+    if (pop.empty()) {
+        if (error) *error = populationFile + " is not a saved population";
+        return false;
+    }
+
+    auto best = std::max_element(pop.begin(), pop.end(),
+        [](const Individual& x, const Individual& y) { return x.fitness < y.fitness; });
+    out = best->w;
+    return true;
+}
+
+void suggestMoves(const std::vector<MoveRequest>& requests, const Weights& w,
+                  std::vector<MoveSuggestion>& out, int threadCount)
+{
+    TRACE_SCOPE("suggestMoves");
+    out.resize(requests.size());
+    const std::size_t count = requests.size();
+    const std::size_t tasks = std::max<std::size_t>(1,
+        std::min(std::size_t(std::max(1, threadCount)), count / kMinBoardsPerTask));
+
+    std::vector<std::future<void>> futures;
+    for (std::size_t t = 1; t < tasks; ++t) {
+        const std::size_t begin = count * t / tasks;
+        const std::size_t end   = count * (t + 1) / tasks;
+        futures.emplace_back(std::async(std::launch::async, [&, begin, end] {
+            suggestRange(requests.data() + begin, end - begin, w, out.data() + begin);
+        }));
+    }
+    suggestRange(requests.data(), count / tasks, w, out.data());
+    for (auto& f : futures) f.get();
+}
+
+struct MoveService::Client {
+    int fd = -1;
+    FrameReader reader{kMaxBacklog};
+    FrameWriter writer;
+};
+
+MoveService::MoveService(const Weights& w, const MoveServiceOptions& opt)
+    : m_weights(w), m_opt(opt) {
+}
+
+MoveService::~MoveService() {
+    for (auto& c : m_clients) closeSocket(c.fd);
+    closeSocket(m_listenFd);
+}
+
+bool MoveService::start(const std::string& endpoint, std::string* error) {
+    m_listenFd = listenOn(endpoint, error);
+    if (m_listenFd < 0) return false;
+    setNonBlocking(m_listenFd, true);
+    m_samples.reserve(kMaxSamples);
+    m_lastReportUs = nowUs();
+    return true;
+}
+
+void MoveService::acceptClients() {
+    for (;;) {
+        int fd = acceptClient(m_listenFd);
+        if (fd < 0) return;
+        setNonBlocking(fd, true);
+
+        Client c;
+        c.fd = fd;
+        m_clients.push_back(std::move(c));
+    }
+}
+
+void MoveService::run() {
+    while (!m_stop) {
+        serveBatch();
+        if (m_opt.reportIntervalMs > 0
+            && nowUs() - m_lastReportUs >= std::int64_t(m_opt.reportIntervalMs) * 1000) {
+            report();
+        }
+    }
+}
+
+void MoveService::serveBatch() {
+    std::vector<pollfd> fds;
+    fds.push_back({m_listenFd, POLLIN, 0});
+    for (const auto& c : m_clients)
+        fds.push_back({c.fd, short(c.writer.pending() > 0 ? POLLIN | POLLOUT : POLLIN), 0});
+    {
+        TRACE_SCOPE("MoveService: wait for requests");
+        ::poll(fds.data(), fds.size(), kPollIntervalMs);
+    }
+
+    // Requests from every frame that is ready go into one batch; each frame
+    // remembers its client and its slice of the batch. Replies go out in
+    // arrival order, stats included, so pipelining clients stay in step.
+    struct PendingFrame {
+        std::size_t  client;
+        std::size_t  begin;
+        std::size_t  count;
+        std::int64_t receivedUs;
+        bool         stats;
+    };
+    std::vector<MoveRequest> requests;
+    std::vector<PendingFrame> frames;
+    std::vector<bool> alive(m_clients.size(), true);
+
+    // fds[1..] line up with the clients that existed before accepting.
+    for (std::size_t ci = 0; ci + 1 < fds.size(); ++ci) {
+        Client& c = m_clients[ci];
+        if ((fds[ci + 1].revents & POLLOUT) && !c.writer.writeTo(c.fd)) alive[ci] = false;
+        if (!alive[ci] || !(fds[ci + 1].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+        alive[ci] = c.reader.readFrom(c.fd);
+        const std::int64_t receivedUs = nowUs();
+
+        Frame frame;
+        while (c.reader.next(frame)) {
+            if (frame.type == MsgStats) {
+                frames.push_back({ci, requests.size(), 0, receivedUs, true});
+                continue;
+            }
+            if (frame.type != MsgSuggest) continue;
+
+            PayloadReader in(frame.payload);
+            std::uint32_t count = 0;
+            in.u32(count);
+            const std::size_t begin = requests.size();
+            for (std::uint32_t k = 0; k < count && in.ok(); ++k) {
+                MoveRequest r;
+                std::uint8_t size = 0;
+                if (!(in.u64(r.id) && in.u8(size) && in.u64(r.board))) break;
+                r.size = size;
+                requests.push_back(r);
+            }
+            if (!in.ok()) {
+                requests.resize(begin);
+                alive[ci] = false;
+                break;
+            }
+            frames.push_back({ci, begin, requests.size() - begin, receivedUs, false});
+        }
+        if (c.reader.corrupt()) alive[ci] = false;
+    }
+
+    std::vector<MoveSuggestion> suggestions;
+    if (!requests.empty()) {
+        suggestMoves(requests, m_weights, suggestions, m_opt.threadCount);
+        ++m_batches;
+    }
+
+    for (const PendingFrame& f : frames) {
+        if (!alive[f.client]) continue;
+        PayloadWriter out;
+        if (f.stats) {
+            const MoveServiceStats s = stats();
+            out.u32(kProtocolVersion);
+            out.u64(s.requests);
+            out.u64(s.batches);
+            out.f64(s.qps);
+            out.f64(s.p50Us);
+            out.f64(s.p99Us);
+            out.f64(s.meanBatch);
+        } else {
+            out.u32(std::uint32_t(f.count));
+            for (std::size_t i = f.begin; i < f.begin + f.count; ++i) {
+                out.u64(suggestions[i].id);
+                out.u8(std::uint8_t(suggestions[i].direction));
+                out.f64(suggestions[i].score);
+            }
+        }
+        // Replies queue up behind whatever the client has not read yet; a
+        // client that stops reading is dropped instead of stalling the rest.
+        Client& c = m_clients[f.client];
+        c.writer.queue(f.stats ? MsgStatsReply : MsgSuggestions, out.data());
+        if (!c.writer.writeTo(c.fd) || c.writer.pending() > kMaxBacklog) {
+            alive[f.client] = false;
+            continue;
+        }
+        if (!f.stats) record(f.receivedUs, nowUs(), f.count);
+    }
+
+    for (std::size_t ci = alive.size(); ci-- > 0; ) {
+        if (alive[ci]) continue;
+        closeSocket(m_clients[ci].fd);
+        m_clients.erase(m_clients.begin() + ci);
+    }
+    if (fds[0].revents & POLLIN) acceptClients();
+}
+
+void MoveService::record(std::int64_t receivedUs, std::int64_t doneUs, std::size_t boards) {
+    m_requests += boards;
+    const Sample s{doneUs, float(doneUs - receivedUs)};
+    for (std::size_t i = 0; i < boards; ++i) {
+        if (m_samples.size() < kMaxSamples) {
+            m_samples.push_back(s);
+        } else {
+            m_samples[m_sampleNext] = s;
+        }
+        m_sampleNext = (m_sampleNext + 1) % kMaxSamples;
+    }
+}
+
+MoveServiceStats MoveService::stats() const {
+    MoveServiceStats s;
+    s.requests  = m_requests;
+    s.batches   = m_batches;
+    s.meanBatch = m_batches ? double(m_requests) / double(m_batches) : 0.0;
+
+    const std::int64_t now = nowUs();
+    const std::int64_t windowStart = now - std::int64_t(m_opt.statsWindowMs) * 1000;
+    std::vector<float> latencies;
+    std::int64_t oldest = now;
+    for (const Sample& sample : m_samples) {
+        if (sample.doneUs < windowStart) continue;
+        latencies.push_back(sample.latencyUs);
+        oldest = std::min(oldest, sample.doneUs);
+    }
+    if (latencies.empty()) return s;
+
+    // With the ring full, the window is however far back the ring reaches.
+    const double seconds = double(std::max<std::int64_t>(now - std::max(oldest, windowStart),
+                                                         1000)) / 1e6;
+    const std::size_t full = latencies.size();
+    s.qps = double(full) / seconds;
+
+    auto percentile = [&](double p) {
+        const std::size_t k = std::min(full - 1, std::size_t(p * double(full)));
+        std::nth_element(latencies.begin(), latencies.begin() + k, latencies.end());
+        return double(latencies[k]);
+    };
+    s.p50Us = percentile(0.50);
+    s.p99Us = percentile(0.99);
+    return s;
+}
+
+void MoveService::report() {
+    m_lastReportUs = nowUs();
+    const MoveServiceStats s = stats();
+    std::cout << "move service: " << s.qps << " req/s, p50 " << s.p50Us
+              << " us, p99 " << s.p99Us << " us, " << s.meanBatch
+              << " boards/batch, " << m_clients.size() << " clients, "
+              << s.requests << " served" << std::endl;
+}
+
+MoveClient::~MoveClient() {
+    close();
+}
+
+bool MoveClient::connect(const std::string& endpoint, std::string* error) {
+    close();
+    m_fd = connectTo(endpoint, error);
+    return m_fd >= 0;
+}
+
+void MoveClient::close() {
+    closeSocket(m_fd);
+    m_fd = -1;
+}
+
+bool MoveClient::suggest(const std::vector<MoveRequest>& requests,
+                         std::vector<MoveSuggestion>& out)
+{
+    PayloadWriter req;
+    req.u32(std::uint32_t(requests.size()));
+    for (const MoveRequest& r : requests) {
+        req.u64(r.id);
+        req.u8(std::uint8_t(r.size));
+        req.u64(r.board);
+    }
+    Frame frame;
+    if (!sendFrame(m_fd, MsgSuggest, req.data()) || !recvFrame(m_fd, frame)
+        || frame.type != MsgSuggestions) return false;
+
+    PayloadReader in(frame.payload);
+    std::uint32_t count = 0;
+    if (!in.u32(count) || count != requests.size()) return false;
+    out.resize(count);
+    for (auto& s : out) {
+        std::uint8_t dir = 0;
+        if (!(in.u64(s.id) && in.u8(dir) && in.f64(s.score))) return false;
+        s.direction = dir;
+    }
+    return true;
+}
+
+bool MoveClient::stats(MoveServiceStats& out) {
+    Frame frame;
+    if (!sendFrame(m_fd, MsgStats, {}) || !recvFrame(m_fd, frame)
+        || frame.type != MsgStatsReply) return false;
+
+    PayloadReader in(frame.payload);
+    std::uint32_t version = 0;
+    return in.u32(version) && version == kProtocolVersion
+        && in.u64(out.requests) && in.u64(out.batches) && in.f64(out.qps)
+        && in.f64(out.p50Us) && in.f64(out.p99Us) && in.f64(out.meanBatch);
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ai2048.h"
+#include "bitboard2048.h"
+
+// A local daemon that answers chooseMove()-style suggestions for other
+// tools (see netio.h for the endpoint syntax and frame format). POSIX only.
+//
+// A request frame carries any number of packed boards; the reply carries,
+// for each, the direction whose afterstate scores best under the served
+// weights, or NoMove when nothing moves. Afterstates are scored without a
+// spawn, so answers are deterministic. Everything that arrived during one
+// poll round, over all clients, is scored in a single evaluateBoards() pass:
+// the busier the service, the larger its batches. Replies wait in a queue
+// per client, so one slow reader cannot stall the others; a client whose
+// backlog grows past a few megabytes is disconnected.
+
+struct MoveRequest {
+    std::uint64_t id    = 0;   // echoed back
+    Board64       board = 0;
+    int           size  = 4;   // 1..4
+};
+
+struct MoveSuggestion {
+    static constexpr int NoMove = 255;
+
+    std::uint64_t id        = 0;
+    int           direction = NoMove;   // Direction as an int
+    double        score     = 0.0;
+};
+
+struct MoveServiceOptions {
+    int threadCount      = 1;       // evaluation threads for large batches
+    int reportIntervalMs = 10000;   // periodic stats on stdout; 0 turns them off
+    int statsWindowMs    = 10000;   // latency and QPS cover this much history
+};
+
+struct MoveServiceStats {
+    std::uint64_t requests  = 0;    // boards answered since start
+    std::uint64_t batches   = 0;
+    double        qps       = 0.0;  // over the stats window
+    double        p50Us     = 0.0;  // from frame arrival to reply queued
+    double        p99Us     = 0.0;
+    double        meanBatch = 0.0;  // boards per evaluation pass
+};
+
+// Picks the fittest individual of a file written by savePopulation().
+bool loadBestWeights(const std::string& populationFile, Weights& out,
+                     std::string* error = nullptr);
+
+// Scores every request's afterstates with one evaluateBoards() call per
+// thread and fills out[i] for requests[i].
+void suggestMoves(const std::vector<MoveRequest>& requests, const Weights& w,
+                  std::vector<MoveSuggestion>& out, int threadCount = 1);
+
+class MoveService {
+public:
+    MoveService(const Weights& w, const MoveServiceOptions& opt = MoveServiceOptions());
+    ~MoveService();
+
+    MoveService(const MoveService&) = delete;
+    MoveService& operator=(const MoveService&) = delete;
+
+    bool start(const std::string& endpoint, std::string* error = nullptr);
+
+    // Serves until stop(); safe to call stop() from a signal handler.
+    void run();
+    void stop() { m_stop = true; }
+
+    // Only meaningful from the thread that runs the service.
+    MoveServiceStats stats() const;
+
+private:
+    struct Client;
+    struct Sample {
+        std::int64_t doneUs;
+        float        latencyUs;
+    };
+
+    void acceptClients();
+    void serveBatch();
+    void record(std::int64_t receivedUs, std::int64_t doneUs, std::size_t boards);
+    void report();
+
+    Weights m_weights;
+    MoveServiceOptions m_opt;
+    int m_listenFd = -1;
+    std::vector<Client> m_clients;
+    std::atomic<bool> m_stop{false};
+
+    std::vector<Sample> m_samples;   // ring buffer
+    std::size_t m_sampleNext = 0;
+    std::uint64_t m_requests = 0;
+    std::uint64_t m_batches = 0;
+    std::int64_t m_lastReportUs = 0;
+};
+
+// Blocking client for tools that talk to the service.
+class MoveClient {
+public:
+    MoveClient() = default;
+    ~MoveClient();
+
+    MoveClient(const MoveClient&) = delete;
+    MoveClient& operator=(const MoveClient&) = delete;
+
+    bool connect(const std::string& endpoint, std::string* error = nullptr);
+    void close();
+
+    bool suggest(const std::vector<MoveRequest>& requests, std::vector<MoveSuggestion>& out);
+    bool stats(MoveServiceStats& out);
+
+private:
+    int m_fd = -1;
+};
@@ -0,0 +1,376 @@
+#include "netio.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// How long a send waits for room on a non-blocking socket before the peer
+// counts as dead.
+static constexpr int kSendTimeoutMs = 10000;
+
+static bool isUnixEndpoint(const std::string& endpoint) {
+    return endpoint.rfind("unix:", 0) == 0;
+}
+
+static void setError(std::string* error, const std::string& what) {
+    if (error) *error = what + ": " + std::strerror(errno);
+}
+
+static bool splitHostPort(const std::string& endpoint, std::string& host, std::string& port) {
+    auto colon = endpoint.rfind(':');
+    if (colon == std::string::npos) return false;
+    host = endpoint.substr(0, colon);
+    port = endpoint.substr(colon + 1);
+    if (host.empty()) host = "127.0.0.1";
+    return !port.empty();
+}
+
+static bool unixAddress(const std::string& endpoint, sockaddr_un& addr) {
+    const std::string path = endpoint.substr(5);
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::memcpy(addr.sun_path, path.c_str(), path.size());
+    return true;
+}
+
+int listenOn(const std::string& endpoint, std::string* error)
+{
+    if (isUnixEndpoint(endpoint)) {
+        sockaddr_un addr;
+        if (!unixAddress(endpoint, addr)) {
+            if (error) *error = "bad unix socket path";
+            return -1;
+        }
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) { setError(error, "socket"); return -1; }
+        ::unlink(addr.sun_path);
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+            || ::listen(fd, 64) < 0) {
+            setError(error, "bind/listen");
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    std::string host, port;
+    if (!splitHostPort(endpoint, host, port)) {
+        if (error) *error = "endpoint must be unix:/path or host:port";
+        return -1;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* res = nullptr;
+    if (::getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0 || !res) {
+        if (error) *error = "cannot resolve " + host;
+        return -1;
+    }
+
+    int fd = -1;
+    for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        int one = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (::bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 && ::listen(fd, 64) == 0)
+            break;
+        ::close(fd);
+        fd = -1;
+    }
+    if (fd < 0) setError(error, "bind/listen");
+    ::freeaddrinfo(res);
+    return fd;
+}
+
+int connectTo(const std::string& endpoint, std::string* error)
+{
+    if (isUnixEndpoint(endpoint)) {
+        sockaddr_un addr;
+        if (!unixAddress(endpoint, addr)) {
+            if (error) *error = "bad unix socket path";
+            return -1;
+        }
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) { setError(error, "socket"); return -1; }
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+            setError(error, "connect");
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    std::string host, port;
+    if (!splitHostPort(endpoint, host, port)) {
+        if (error) *error = "endpoint must be unix:/path or host:port";
+        return -1;
+    }
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* res = nullptr;
+    if (::getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0 || !res) {
+        if (error) *error = "cannot resolve " + host;
+        return -1;
+    }
+
+    int fd = -1;
+    for (addrinfo* ai = res; ai; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            int one = 1;
+            ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            break;
+        }
+        ::close(fd);
+        fd = -1;
+    }
+    if (fd < 0) setError(error, "connect");
+    ::freeaddrinfo(res);
+    return fd;
+}
+
+int acceptClient(int listenFd)
+{
+    int fd = ::accept(listenFd, nullptr, nullptr);
+    if (fd >= 0) {
+        int one = 1;
+        // Fails harmlessly on unix sockets.
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+void closeSocket(int fd)
+{
+    if (fd >= 0) ::close(fd);
+}
+
+bool setNonBlocking(int fd, bool on)
+{
+    int flags = ::fcntl(fd, F_GETFL, 0);
+    if (flags < 0) return false;
+    flags = on ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return ::fcntl(fd, F_SETFL, flags) == 0;
+}
+
+static bool writeAll(int fd, const std::uint8_t* data, std::size_t len)
+{
+    while (len > 0) {
+        ssize_t n = ::send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            // Non-blocking peers: wait for room rather than dropping a frame,
+            // but not for a peer that has stopped reading.
+            pollfd pfd{fd, POLLOUT, 0};
+            const int ready = ::poll(&pfd, 1, kSendTimeoutMs);
+            if (ready < 0 && errno == EINTR) continue;
+            if (ready <= 0) return false;
+            continue;
+        }
+        if (n <= 0) return false;
+        data += n;
+        len  -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+static bool readAll(int fd, std::uint8_t* data, std::size_t len)
+{
+    while (len > 0) {
+        ssize_t n = ::recv(fd, data, len, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        len  -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+static std::uint32_t readLength(const std::uint8_t* p)
+{
+    return std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8)
+         | (std::uint32_t(p[2]) << 16) | (std::uint32_t(p[3]) << 24);
+}
+
+static void appendFrame(std::vector<std::uint8_t>& buf, std::uint8_t type,
+                        const std::vector<std::uint8_t>& payload)
+{
+    const std::uint32_t len = static_cast<std::uint32_t>(payload.size() + 1);
+    buf.reserve(buf.size() + 5 + payload.size());
+    for (int i = 0; i < 4; ++i) buf.push_back(std::uint8_t(len >> (8 * i)));
+    buf.push_back(type);
+    buf.insert(buf.end(), payload.begin(), payload.end());
+}
+
+bool sendFrame(int fd, std::uint8_t type, const std::vector<std::uint8_t>& payload)
+{
+    std::vector<std::uint8_t> buf;
+    appendFrame(buf, type, payload);
+    return writeAll(fd, buf.data(), buf.size());
+}
+
+bool recvFrame(int fd, Frame& out)
+{
+    std::uint8_t header[5];
+    if (!readAll(fd, header, 5)) return false;
+
+    const std::uint32_t len = readLength(header);
+    if (len == 0 || len > kMaxFrame) return false;
+
+    out.type = header[4];
+    out.payload.resize(len - 1);
+    return out.payload.empty() || readAll(fd, out.payload.data(), out.payload.size());
+}
+
+bool FrameReader::readFrom(int fd)
+{
+    std::uint8_t chunk[16384];
+    while (unread() < m_maxBuffered) {
+        const std::size_t room = std::min(sizeof(chunk), m_maxBuffered - unread());
+        ssize_t n = ::recv(fd, chunk, room, 0);
+        if (n > 0) {
+            m_buf.insert(m_buf.end(), chunk, chunk + n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        return false;
+    }
+    return true;
+}
+
+bool FrameReader::next(Frame& out)
+{
+    // Compact once the consumed prefix dominates, so a burst of small
+    // frames costs one move instead of one per frame.
+    if (m_read == m_buf.size()) {
+        m_buf.clear();
+        m_read = 0;
+    } else if (m_read > m_buf.size() / 2) {
+        m_buf.erase(m_buf.begin(), m_buf.begin() + std::ptrdiff_t(m_read));
+        m_read = 0;
+    }
+    if (unread() < 5) return false;
+
+    const std::uint8_t* frame = m_buf.data() + m_read;
+    const std::uint32_t len = readLength(frame);
+    if (len == 0 || len > kMaxFrame || 4 + std::size_t(len) > m_maxBuffered) {
+        m_corrupt = true;
+        return false;
+    }
+    if (unread() < 4 + std::size_t(len)) return false;
+
+    out.type = frame[4];
+    out.payload.assign(frame + 5, frame + 4 + len);
+    m_read += 4 + std::size_t(len);
+    return true;
+}
+
+void FrameWriter::queue(std::uint8_t type, const std::vector<std::uint8_t>& payload)
+{
+    appendFrame(m_buf, type, payload);
+}
+
+bool FrameWriter::writeTo(int fd)
+{
+    while (m_sent < m_buf.size()) {
+        ssize_t n = ::send(fd, m_buf.data() + m_sent, m_buf.size() - m_sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            m_sent += std::size_t(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        return false;
+    }
+    // Compact once the sent prefix dominates, so the buffer stays at about
+    // the backlog's size.
+    if (m_sent == m_buf.size()) {
+        m_buf.clear();
+        m_sent = 0;
+    } else if (m_sent > m_buf.size() / 2) {
+        m_buf.erase(m_buf.begin(), m_buf.begin() + std::ptrdiff_t(m_sent));
+        m_sent = 0;
+    }
+    return true;
+}
+
+void PayloadWriter::put(std::uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i) m_data.push_back(std::uint8_t(v >> (8 * i)));
+}
+
+void PayloadWriter::f64(double v)
+{
+    std::uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    put(bits, 8);
+}
+
+bool PayloadReader::get(std::uint64_t& v, int bytes)
+{
+    if (!m_ok || m_pos + bytes > m_data.size()) {
+        m_ok = false;
+        return false;
+    }
+    v = 0;
+    for (int i = 0; i < bytes; ++i) v |= std::uint64_t(m_data[m_pos + i]) << (8 * i);
+    m_pos += bytes;
+    return true;
+}
+
+bool PayloadReader::u8(std::uint8_t& v)
+{
+    std::uint64_t t;
+    if (!get(t, 1)) return false;
+    v = std::uint8_t(t);
+    return true;
+}
+
+bool PayloadReader::u32(std::uint32_t& v)
+{
+    std::uint64_t t;
+    if (!get(t, 4)) return false;
+    v = std::uint32_t(t);
+    return true;
+}
+
+bool PayloadReader::u64(std::uint64_t& v)
+{
+    return get(v, 8);
+}
+
+bool PayloadReader::i32(std::int32_t& v)
+{
+    std::uint32_t t;
+    if (!u32(t)) return false;
+    v = static_cast<std::int32_t>(t);
+    return true;
+}
+
+bool PayloadReader::f64(double& v)
+{
+    std::uint64_t bits;
+    if (!get(bits, 8)) return false;
+    std::memcpy(&v, &bits, sizeof(v));
+    return true;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Socket helpers and a length-prefixed frame format shared by the fitness
+// workers and the move service. POSIX only.
+//
+// Endpoints are either "unix:/path/to/socket" or "host:port" for TCP.
+// A frame is a little-endian u32 length, then a u8 type and length - 1
+// bytes of payload.
+
+int  listenOn(const std::string& endpoint, std::string* error = nullptr);
+int  connectTo(const std::string& endpoint, std::string* error = nullptr);
+int  acceptClient(int listenFd);
+void closeSocket(int fd);
+bool setNonBlocking(int fd, bool on);
+
+// Longest length field a frame may carry.
+constexpr std::uint32_t kMaxFrame = 64u << 20;
+
+struct Frame {
+    std::uint8_t type = 0;
+    std::vector<std::uint8_t> payload;
+};
+
+// False on error, or if a non-blocking socket has had no room for ten
+// seconds; the peer should then be treated as gone.
+bool sendFrame(int fd, std::uint8_t type, const std::vector<std::uint8_t>& payload);
+// Blocks until a whole frame has arrived; false on EOF, error or a
+// malformed length.
+bool recvFrame(int fd, Frame& out);
+
+// Collects bytes from a non-blocking socket and hands out whole frames.
+// At most maxBuffered unread bytes are held; the rest stays in the socket
+// until next() has consumed some, and a frame too long to ever fit makes
+// the stream corrupt.
+class FrameReader {
+public:
+    explicit FrameReader(std::size_t maxBuffered = 4 + std::size_t(kMaxFrame))
+        : m_maxBuffered(maxBuffered) {}
+
+    // Drains what the socket has, up to the limit; false once the peer
+    // closed or errored.
+    bool readFrom(int fd);
+    bool next(Frame& out);
+    bool corrupt() const { return m_corrupt; }
+
+private:
+    std::size_t unread() const { return m_buf.size() - m_read; }
+
+    std::size_t m_maxBuffered;
+    std::vector<std::uint8_t> m_buf;
+    std::size_t m_read = 0;
+    bool m_corrupt = false;
+};
+
+// Queues frames for a non-blocking socket and sends what the socket takes;
+// the rest waits for the next writeTo(), typically on POLLOUT.
+class FrameWriter {
+public:
+    void queue(std::uint8_t type, const std::vector<std::uint8_t>& payload);
+    // False once the peer closed or errored.
+    bool writeTo(int fd);
+    std::size_t pending() const { return m_buf.size() - m_sent; }
+
+private:
+    std::vector<std::uint8_t> m_buf;
+    std::size_t m_sent = 0;
+};
+
+class PayloadWriter {
+public:
+    void u8(std::uint8_t v)   { m_data.push_back(v); }
+    void u32(std::uint32_t v) { put(v, 4); }
+    void u64(std::uint64_t v) { put(v, 8); }
+    void i32(std::int32_t v)  { put(static_cast<std::uint32_t>(v), 4); }
+    void f64(double v);
+
+    const std::vector<std::uint8_t>& data() const { return m_data; }
+
+private:
+    void put(std::uint64_t v, int bytes);
+    std::vector<std::uint8_t> m_data;
+};
+
+// Reads fail (and stay failed) once the payload runs out.
+class PayloadReader {
+public:
+    explicit PayloadReader(const std::vector<std::uint8_t>& data) : m_data(data) {}
+
+    bool u8(std::uint8_t& v);
+    bool u32(std::uint32_t& v);
+    bool u64(std::uint64_t& v);
+    bool i32(std::int32_t& v);
+    bool f64(double& v);
+
+    bool ok() const { return m_ok; }
+
+private:
+    bool get(std::uint64_t& v, int bytes);
+
+    const std::vector<std::uint8_t>& m_data;
+    std::size_t m_pos = 0;
+    bool m_ok = true;
+};
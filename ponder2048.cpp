@@ -0,0 +1,172 @@
+#include "ponder2048.h"
+#include "trace2048.h"
+
+#include <vector>
+
+Ponderer::Ponderer(const Weights& w, const SearchOptions& rootOptions,
+                   const SearchOptions& replyOptions)
+    : m_weights(w)
+    , m_rootOptions(rootOptions)
+    , m_replyOptions(replyOptions)
+    , m_thread(&Ponderer::run, this) {
+}
+
+Ponderer::~Ponderer() {
+    {
+        std::scoped_lock lock(m_mutex);
+        m_stop = true;
+    }
+    m_cancel = true;
+    m_cv.notify_all();
+    m_thread.join();
+}
+
+void Ponderer::setOnReady(std::function<void(const PonderResult&)> onReady) {
+    std::scoped_lock lock(m_mutex);
+    m_onReady = std::move(onReady);
+}
+
+void Ponderer::setPosition(const Game2048& game) {
+    {
+        std::scoped_lock lock(m_mutex);
+        Board64 key = 0;
+        const bool packable = packBoard(game, key);
+        const bool sameSize = m_hasPosition && m_position.size() == game.size();
+
+        // Everything but the new position itself is now unreachable.
+        auto kept = m_results.find(key);
+        if (packable && sameSize && kept != m_results.end()) {
+            const PonderResult result = kept->second;
+            m_results.clear();
+            m_results.emplace(key, result);
+        } else {
+            m_results.clear();
+        }
+
+        m_position = game;
+        m_hasPosition = packable;
+        ++m_epoch;
+        m_cancel = true;
+    }
+    m_cv.notify_all();
+}
+
+bool Ponderer::lookup(const Game2048& game, PonderResult& out) const {
+    Board64 key = 0;
+    std::scoped_lock lock(m_mutex);
+    auto it = m_results.end();
+    if (m_hasPosition && game.size() == m_position.size() && packBoard(game, key))
+        it = m_results.find(key);
+    if (it == m_results.end()) {
+        ++m_misses;
+        return false;
+    }
+    ++m_hits;
+    out = it->second;
+    return true;
+}
+
+long long Ponderer::searched() const {
+    std::scoped_lock lock(m_mutex);
+    return m_searched;
+}
+
+long long Ponderer::hits() const {
+    std::scoped_lock lock(m_mutex);
+    return m_hits;
+}
+
+long long Ponderer::misses() const {
+    std::scoped_lock lock(m_mutex);
+    return m_misses;
+}
+
+// Searches one position unless it is already known; false once the epoch
+// is over, in which case nothing is stored.
+bool Ponderer::searchInEpoch(const Game2048& game, bool reply,
+                             std::uint64_t epoch, PonderResult* out) {
+    Board64 key = 0;
+    if (!packBoard(game, key)) return true;
+    {
+        std::scoped_lock lock(m_mutex);
+        if (epoch != m_epoch) return false;
+        auto it = m_results.find(key);
+        // Replies are searched with less effort; the position's own search
+        // replaces them.
+        if (it != m_results.end() && reply) {
+            if (out) *out = it->second;
+            return true;
+        }
+    }
+
+    SearchOptions opt = reply ? m_replyOptions : m_rootOptions;
+    opt.cancel = &m_cancel;
+    PonderResult result;
+    result.move = searchMove(game, m_weights, opt, &result.stats);
+
+    std::scoped_lock lock(m_mutex);
+    if (epoch != m_epoch) return false;
+    m_results[key] = result;
+    ++m_searched;
+    if (out) *out = result;
+    return true;
+}
+
+void Ponderer::run() {
+    setTraceThreadName("ponder");
+    std::unique_lock lock(m_mutex);
+    for (;;) {
+        m_cv.wait(lock, [this] { return m_stop || (m_hasPosition && m_doneEpoch != m_epoch); });
+        if (m_stop) return;
+
+        const std::uint64_t epoch = m_epoch;
+        const Game2048 root = m_position;
+        m_cancel = false;
+        lock.unlock();
+
+        TRACE_SCOPE("Ponderer: position");
+        PonderResult best;
+        bool current = searchInEpoch(root, false, epoch, &best);
+        if (current) {
+            std::function<void(const PonderResult&)> onReady;
+            {
+                std::scoped_lock guard(m_mutex);
+                onReady = m_onReady;
+            }
+            if (onReady) onReady(best);
+        }
+
+        // Positions after each move and spawn, the likeliest first.
+        std::vector<Game2048> afterstates;
+        const Direction order[] = {best.move, Direction::Left, Direction::Right,
+                                   Direction::Up, Direction::Down};
+        for (int i = 0; i < 5 && current; ++i) {
+            if (i > 0 && order[i] == best.move) continue;
+            Game2048 after = root;
+            after.setAutoSpawn(false);
+            bool moved = false;
+            switch (order[i]) {
+            case Direction::Left:  moved = after.moveLeft();  break;
+            case Direction::Right: moved = after.moveRight(); break;
+            case Direction::Up:    moved = after.moveUp();    break;
+            case Direction::Down:  moved = after.moveDown();  break;
+            }
+            if (moved) afterstates.push_back(after);
+        }
+
+        const int n = root.size();
+        for (int tile : {2, 4}) {
+            for (const Game2048& after : afterstates) {
+                for (int cell = 0; cell < n * n && current; ++cell) {
+                    if (after.at(cell / n, cell % n) != 0) continue;
+                    Game2048 reply = after;
+                    reply.setTile(cell / n, cell % n, tile);
+                    current = searchInEpoch(reply, true, epoch);
+                }
+            }
+        }
+
+        lock.lock();
+        if (epoch == m_epoch) m_doneEpoch = epoch;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "bitboard2048.h"
+#include "game2048.h"
+#include "search2048.h"
+
+struct PonderResult {
+    Direction   move = Direction::Left;
+    SearchStats stats;
+};
+
+// Searches on a background thread while the player is thinking.
+//
+// For the position given to setPosition() it first finds the best move
+// with rootOptions, then the best reply to each position the next move
+// could lead to - the best move's spawns first, 2-spawns before 4-spawns -
+// with replyOptions. setPosition() abandons whatever is running and keeps
+// only the result for the new position itself, so a move the player did
+// make usually finds its reply ready.
+//
+// Only boards that packBoard() covers are pondered.
+class Ponderer {
+public:
+    Ponderer(const Weights& w, const SearchOptions& rootOptions,
+             const SearchOptions& replyOptions);
+    ~Ponderer();
+
+    Ponderer(const Ponderer&) = delete;
+    Ponderer& operator=(const Ponderer&) = delete;
+
+    // Called on the pondering thread whenever the current position's own
+    // move is ready. Set it before the first setPosition().
+    void setOnReady(std::function<void(const PonderResult&)> onReady);
+
+    void setPosition(const Game2048& game);
+
+    // The pondered move for this position, if there is one yet.
+    bool lookup(const Game2048& game, PonderResult& out) const;
+
+    long long searched() const;   // positions pondered to completion
+    long long hits() const;       // lookups answered
+    long long misses() const;
+
+private:
+    void run();
+    bool searchInEpoch(const Game2048& game, bool reply,
+                       std::uint64_t epoch, PonderResult* out = nullptr);
+
+    const Weights       m_weights;
+    const SearchOptions m_rootOptions;
+    const SearchOptions m_replyOptions;
+    std::function<void(const PonderResult&)> m_onReady;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::atomic<bool> m_cancel{false};
+
+    Game2048      m_position;
+    bool          m_hasPosition = false;
+    std::uint64_t m_epoch = 0;        // bumped by every setPosition()
+    std::uint64_t m_doneEpoch = 0;
+    bool          m_stop = false;
+
+    std::unordered_map<Board64, PonderResult> m_results;
+    long long m_searched = 0;
+    mutable long long m_hits = 0;
+    mutable long long m_misses = 0;
+
+    std::thread m_thread;
+};
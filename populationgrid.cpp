@@ -0,0 +1,201 @@
+#include "populationgrid.h"
+#include "game2048.h"
+#include "trace2048.h"
+
+#include <QPaintEvent>
+#include <QPainter>
+#include <QTimer>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr int kMaxExponent = 20;   // beyond any tile a played-out game reaches
+
+// The BoardWidget palette, indexed by exponent.
+QColor tileColor(int e) {
+    static const char* const colors[] = {
+        "#cdc1b4", "#eee4da", "#ede0c8", "#f2b179", "#f59563", "#f67c5f",
+        "#f65e3b", "#edcf72", "#edcc61", "#edc850", "#edc53f", "#edc22e"
+    };
+    return QColor(e < 12 ? colors[e] : "#3c3a32");
+}
+
+QColor textColor(int e) {
+    return (e <= 2) ? QColor("#776e65") : QColor("#f9f6f2");
+}
+
+int exponentOf(int value) {
+    int e = 0;
+    while ((1 << e) < value) ++e;
+    return std::min(e, kMaxExponent);
+}
+
+} // namespace
+
+PopulationGrid::PopulationGrid(QWidget* parent)
+    : QWidget(parent)
+    , m_frameTimer(new QTimer(this)) {
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    m_frameTimer->setSingleShot(true);
+    m_frameTimer->setInterval(FrameMs);
+    connect(m_frameTimer, &QTimer::timeout, this, &PopulationGrid::flushDirty);
+}
+
+void PopulationGrid::setAgentCount(int count) {
+    m_agents.assign(std::max(0, count), Agent());
+    m_dirtyList.clear();
+    relayout();
+    update();
+}
+
+void PopulationGrid::setGame(int agent, const Game2048* game) {
+    m_agents[agent].game = game;
+    markDirty(agent);
+}
+
+void PopulationGrid::setCaption(int agent, const QString& caption) {
+    if (m_agents[agent].caption == caption) return;
+    m_agents[agent].caption = caption;
+    markDirty(agent);
+}
+
+void PopulationGrid::markDirty(int agent) {
+    Agent& a = m_agents[agent];
+    if (!a.dirty) {
+        a.dirty = true;
+        m_dirtyList.push_back(agent);
+    }
+    if (!m_frameTimer->isActive()) m_frameTimer->start();
+}
+
+void PopulationGrid::markAllDirty() {
+    for (int i = 0; i < agentCount(); ++i) markDirty(i);
+}
+
+void PopulationGrid::flushDirty() {
+    QRegion region;
+    for (int i : m_dirtyList) {
+        m_agents[i].dirty = false;
+        region += cellRect(i);
+    }
+    m_dirtyList.clear();
+    if (!region.isEmpty()) update(region);
+}
+
+void PopulationGrid::resizeEvent(QResizeEvent* e) {
+    QWidget::resizeEvent(e);
+    relayout();
+}
+
+// Picks the column count that gives the largest square cells.
+void PopulationGrid::relayout() {
+    m_captionHeight = fontMetrics().height() + 2;
+    const int count = std::max(1, agentCount());
+
+    m_columns  = 1;
+    m_cellSize = 0;
+    for (int cols = 1; cols <= count; ++cols) {
+        const int rows = (count + cols - 1) / cols;
+        const int size = std::min(width() / cols, height() / rows);
+        if (size > m_cellSize) {
+            m_cellSize = size;
+            m_columns  = cols;
+        }
+    }
+    m_tiles.clear();
+}
+
+QRect PopulationGrid::cellRect(int agent) const {
+    return QRect((agent % m_columns) * m_cellSize, (agent / m_columns) * m_cellSize,
+                 m_cellSize, m_cellSize);
+}
+
+const std::vector<QPixmap>& PopulationGrid::tilesFor(int tileSize) {
+    auto it = m_tiles.find(tileSize);
+    if (it != m_tiles.end()) return it->second;
+
+    const qreal dpr = devicePixelRatioF();
+    std::vector<QPixmap> tiles(kMaxExponent + 1);
+    QFont font = this->font();
+    font.setBold(true);
+
+    for (int e = 0; e <= kMaxExponent; ++e) {
+        QPixmap& pm = tiles[e];
+        pm = QPixmap(int(std::ceil(tileSize * dpr)), int(std::ceil(tileSize * dpr)));
+        pm.setDevicePixelRatio(dpr);
+        pm.fill(QColor("#bbada0"));
+
+        QPainter p(&pm);
+        p.setRenderHint(QPainter::Antialiasing);
+        const QRect r(0, 0, tileSize, tileSize);
+        const int radius = std::max(1, tileSize / 8);
+        p.setPen(Qt::NoPen);
+        p.setBrush(tileColor(e));
+        p.drawRoundedRect(r, radius, radius);
+
+        if (e > 0 && tileSize >= 10) {
+            const int value = 1 << e;
+            const int divisor = (value < 100) ? 3 : (value < 1000 ? 4 : 5);
+            font.setPixelSize(std::max(4, tileSize / divisor));
+            p.setFont(font);
+            p.setPen(textColor(e));
+            p.drawText(r, Qt::AlignCenter, QString::number(value));
+        }
+    }
+    return m_tiles.emplace(tileSize, std::move(tiles)).first->second;
+}
+
+void PopulationGrid::paintAgent(QPainter& p, int agent) {
+    const QRect cell = cellRect(agent).adjusted(2, 2, -2, -2);
+    p.fillRect(cell, palette().window());
+
+    const Agent& a = m_agents[agent];
+    p.setPen(palette().windowText().color());
+    p.drawText(QRect(cell.x(), cell.y(), cell.width(), m_captionHeight),
+               Qt::AlignCenter,
+               fontMetrics().elidedText(a.caption, Qt::ElideRight, cell.width()));
+    if (!a.game) return;
+
+    const int side = std::min(cell.width(), cell.height() - m_captionHeight);
+    if (side <= 0) return;
+    const QRect board(cell.x() + (cell.width() - side) / 2,
+                      cell.y() + m_captionHeight, side, side);
+    p.fillRect(board, QColor("#bbada0"));
+
+    const int n = a.game->size();
+    const int margin = std::max(1, side / (8 * n));
+    const int tile = (side - margin * (n + 1)) / n;
+    if (tile <= 0) return;
+
+    const std::vector<QPixmap>& tiles = tilesFor(tile);
+    for (int r = 0; r < n; ++r) {
+        for (int c = 0; c < n; ++c) {
+            const int value = a.game->at(r, c);
+            p.drawPixmap(board.x() + margin + c * (tile + margin),
+                         board.y() + margin + r * (tile + margin),
+                         tiles[value ? exponentOf(value) : 0]);
+        }
+    }
+}
+
+void PopulationGrid::paintEvent(QPaintEvent* e) {
+    TRACE_SCOPE("PopulationGrid::paintEvent");
+    QPainter p(this);
+    p.fillRect(e->rect(), palette().window());
+    if (m_cellSize <= 0) return;
+
+    // Only the cells the update region touches are drawn.
+    const QRect bounds = e->rect();
+    const int firstRow = bounds.top() / m_cellSize;
+    const int lastRow  = bounds.bottom() / m_cellSize;
+    const int firstCol = bounds.left() / m_cellSize;
+    const int lastCol  = std::min(m_columns - 1, bounds.right() / m_cellSize);
+    for (int row = firstRow; row <= lastRow; ++row) {
+        for (int col = firstCol; col <= lastCol; ++col) {
+            const int agent = row * m_columns + col;
+            if (agent >= agentCount()) break;
+            if (e->region().intersects(cellRect(agent))) paintAgent(p, agent);
+        }
+    }
+}
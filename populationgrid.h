@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QPixmap>
+#include <QString>
+#include <QWidget>
+#include <unordered_map>
+#include <vector>
+
+class Game2048;
+class QTimer;
+
+// Every agent's board and caption drawn by one widget in one paintEvent.
+//
+// Agents that changed are marked dirty; at most once per frame their cells
+// are collected into one region and repainted, and the paint only touches
+// cells inside that region. Tiles are blitted from pixmaps rendered once
+// per tile size instead of being drawn and lettered one by one. Stepping the
+// agents is the owner's business and should stay off the GUI thread.
+class PopulationGrid : public QWidget {
+    Q_OBJECT
+public:
+    explicit PopulationGrid(QWidget* parent = nullptr);
+
+    void setAgentCount(int count);
+    int  agentCount() const { return int(m_agents.size()); }
+
+    // The game is only read while painting and must outlive its use here.
+    void setGame(int agent, const Game2048* game);
+    void setCaption(int agent, const QString& caption);
+
+    // The agent's board changed; its cell is repainted with the next frame.
+    void markDirty(int agent);
+    void markAllDirty();
+
+    QSize sizeHint() const override { return {960, 600}; }
+
+protected:
+    void paintEvent(QPaintEvent* e) override;
+    void resizeEvent(QResizeEvent* e) override;
+
+private:
+    struct Agent {
+        const Game2048* game = nullptr;
+        QString caption;
+        bool dirty = false;
+    };
+
+    static constexpr int FrameMs = 16;
+
+    void  relayout();
+    QRect cellRect(int agent) const;
+    void  flushDirty();
+    void  paintAgent(QPainter& p, int agent);
+    const std::vector<QPixmap>& tilesFor(int tileSize);
+
+    std::vector<Agent> m_agents;
+    std::vector<int>   m_dirtyList;
+    QTimer* m_frameTimer = nullptr;
+
+    int m_columns  = 1;
+    int m_cellSize = 0;
+    int m_captionHeight = 0;
+
+    // Tile pixmaps by exponent (0 = empty), per tile edge in pixels.
+    std::unordered_map<int, std::vector<QPixmap>> m_tiles;
+};
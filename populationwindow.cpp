@@ -1,15 +1,19 @@
 #include "populationwindow.h"
+#include "populationgrid.h"
+#include "search2048.h"
+#include "trace2048.h"
 
-#include <QGridLayout>
 #include <QVBoxLayout>
 #include <QTimer>
 #include <QLabel>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <thread>
 
 PopulationWindow::PopulationWindow(QWidget* parent)
     : QWidget(parent)
-    , m_agents(Count)
     , m_stepTimer(new QTimer(this))
     , m_gaTimer(new QTimer(this))
     , m_population(createInitialPopulation(Count))
@@ -24,45 +28,23 @@ PopulationWindow::PopulationWindow(QWidget* parent)
     m_generationLabel->setAlignment(Qt::AlignCenter);
     m_generationLabel->setText(QString("Generation: %1").arg(m_generation));
 
-    // Сетка агентов
-    auto* grid = new QGridLayout();
-    grid->setSpacing(4);
-    grid->setContentsMargins(0, 0, 0, 0);
+    // Все агенты рисуются одним виджетом
+    m_agents.resize(m_population.size());
+    m_grid = new PopulationGrid(this);
+    m_grid->setAgentCount(int(m_agents.size()));
+    m_grid->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
 
-    int index = 0;
-    for (int r = 0; r < Rows; ++r) {
-        for (int c = 0; c < Cols; ++c) {
-            Agent& a = m_agents[index];
-
-            a.game    = std::make_unique<Game2048>();
-            a.weights = m_population[index].w;
-            a.steps   = 0;
-            a.bestScore = 0;
-            a.bestMoves = 0;
-            a.finished  = false;
-
-            a.boardWidget = new BoardWidget(a.game.get(), this);
-            a.boardWidget->setMinimumSize(80, 80);
-            a.boardWidget->setSizePolicy(QSizePolicy::Expanding,
-                                         QSizePolicy::Expanding);
-
-            a.scoreLabel = new QLabel(this);
-            a.scoreLabel->setAlignment(Qt::AlignCenter);
-            a.scoreLabel->setText("Score: 0 | Best: 0 (0 steps)");
-
-            auto* cellLayout = new QVBoxLayout();
-            cellLayout->addWidget(a.scoreLabel);
-            cellLayout->addWidget(a.boardWidget);
-
-            grid->addLayout(cellLayout, r, c);
-
-            ++index;
-        }
+    for (std::size_t i = 0; i < m_agents.size(); ++i) {
+        Agent& a = m_agents[i];
+        a.game    = std::make_unique<Game2048>();
+        a.weights = m_population[i].w;
+        m_grid->setGame(int(i), a.game.get());
+        updateCaption(int(i), 0);
     }
 
     auto* mainLayout = new QVBoxLayout(this);
     mainLayout->addWidget(m_generationLabel);
-    mainLayout->addLayout(grid);
+    mainLayout->addWidget(m_grid);
     setLayout(mainLayout);
 
     connect(m_stepTimer, &QTimer::timeout,
@@ -75,6 +57,12 @@ PopulationWindow::PopulationWindow(QWidget* parent)
     setPopulation(m_population, m_generation);
 }
 
+PopulationWindow::~PopulationWindow()
+{
+    // The step in flight uses the agents.
+    if (m_stepping.valid()) m_stepping.wait();
+}
+
 void PopulationWindow::setPopulation(const Population& pop, int generation)
 {
     m_generation = generation;
@@ -84,7 +72,7 @@ void PopulationWindow::setPopulation(const Population& pop, int generation)
             QString("Generation: %1").arg(m_generation));
     }
 
-    int n = std::min<int>(Count, pop.size());
+    int n = std::min<int>(m_agents.size(), pop.size());
 
     for (int i = 0; i < n; ++i) {
         Agent& a = m_agents[i];
@@ -96,99 +84,138 @@ void PopulationWindow::setPopulation(const Population& pop, int generation)
         a.bestMoves = 0;
         a.finished  = false;
 
+        a.changed   = false;
+
         if (a.game) {
             a.game->reset();
+            a.next = *a.game;
         }
 
-        if (a.scoreLabel) {
-            a.scoreLabel->setText(
-                QString("Score: 0 | Best: %1 (%2 steps)")
-                    .arg(a.bestScore)
-                    .arg(a.bestMoves));
-        }
-
-        if (a.boardWidget) {
-            a.boardWidget->update();
-        }
+        updateCaption(i, 0);
+        m_grid->markDirty(i);
     }
 }
+
+void PopulationWindow::updateCaption(int index, int score)
+{
+    const Agent& a = m_agents[index];
+    m_grid->setCaption(index, QString("Score: %1 | Best: %2 (%3 steps)")
+                                  .arg(score)
+                                  .arg(a.bestScore)
+                                  .arg(a.bestMoves));
+}
+
 void PopulationWindow::stepAll()
 {
-    bool allFinished = true;
+    TRACE_SCOPE("PopulationWindow::stepAll");
+    if (m_stepping.valid()) {
+        if (m_stepping.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+        finishStep();
+    }
 
-    for (auto& a : m_agents) {
-        if (!a.game) continue;
+    const bool allFinished = std::all_of(m_agents.begin(), m_agents.end(),
+                                         [](const Agent& a) { return !a.game || a.finished; });
+    if (!allFinished) {
+        m_stepping = std::async(std::launch::async, [this] { stepAgents(); });
+        return;
+    }
 
-        if (a.finished) {
-            continue;
-        }
-        allFinished = false;
-
-        if (a.game->isGameOver()) {
-            a.finished = true;
-
-            int finalScore = a.game->score();
-            if (finalScore > a.bestScore) {
-                a.bestScore = finalScore;
-                a.bestMoves = a.steps;
-            }
-
-            if (a.scoreLabel) {
-                a.scoreLabel->setText(
-                    QString("Score: %1 | Best: %2 (%3 steps)")
-                        .arg(finalScore)
-                        .arg(a.bestScore)
-                        .arg(a.bestMoves));
-            }
-
-            continue;
+    if (!m_waitingNextGen) {
+        m_waitingNextGen = true;
+        if (m_gaTimer) {
+            m_gaTimer->start(5000);
         }
+    }
+}
 
-        Direction d = chooseMove(*a.game, a.weights);
+void PopulationWindow::finishStep()
+{
+    if (!m_stepping.valid()) return;
+    m_stepping.get();
 
-        bool moved = false;
-        switch (d) {
-        case Direction::Left:  moved = a.game->moveLeft();  break;
-        case Direction::Right: moved = a.game->moveRight(); break;
-        case Direction::Up:    moved = a.game->moveUp();    break;
-        case Direction::Down:  moved = a.game->moveDown();  break;
-        }
+    for (std::size_t i = 0; i < m_agents.size(); ++i) {
+        Agent& a = m_agents[i];
+        if (!a.changed) continue;
+        a.changed = false;
+        *a.game = a.next;
+        m_grid->markDirty(int(i));
+        updateCaption(int(i), a.next.score());
+    }
+}
+
+void PopulationWindow::stepAgents()
+{
+    TRACE_SCOPE("PopulationWindow::stepAgents");
+    std::atomic<std::size_t> nextAgent{0};
+    auto work = [&] {
+        for (std::size_t i = nextAgent++; i < m_agents.size(); i = nextAgent++)
+            stepAgent(m_agents[i], i == 0);
+    };
+
+    // The showcase search adds ShowcaseThreads - 1 helpers to its pool thread.
+    const std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t helpers = ShowcaseThreads - 1;
+    const std::size_t workers = (cores > helpers) ? cores - helpers : 1;
+    const std::size_t tasks = std::min(workers, m_agents.size());
+    std::vector<std::future<void>> futures;
+    for (std::size_t t = 1; t < tasks; ++t)
+        futures.push_back(std::async(std::launch::async, work));
+    work();
+    for (auto& f : futures) f.get();
+}
+
+void PopulationWindow::stepAgent(Agent& a, bool showcase)
+{
+    if (!a.game || a.finished) return;
+
+    if (a.next.isGameOver()) {
+        a.finished = true;
+        a.changed  = true;
 
-        if (moved) {
-            ++a.steps;
-
-            int curScore = a.game->score();
-            if (curScore > a.bestScore) {
-                a.bestScore = curScore;
-                a.bestMoves = a.steps;
-            }
-
-            if (a.boardWidget) {
-                a.boardWidget->update();
-            }
-            if (a.scoreLabel) {
-                a.scoreLabel->setText(
-                    QString("Score: %1 | Best: %2 (%3 steps)")
-                        .arg(curScore)
-                        .arg(a.bestScore)
-                        .arg(a.bestMoves));
-            }
+        int finalScore = a.next.score();
+        if (finalScore > a.bestScore) {
+            a.bestScore = finalScore;
+            a.bestMoves = a.steps;
         }
+        return;
     }
 
-    if (allFinished && !m_waitingNextGen) {
-        m_waitingNextGen = true;
-        if (m_gaTimer) {
-            m_gaTimer->start(5000);
+    SearchOptions opt;
+    opt.deadlineMs = AgentDeadlineMs;
+    opt.minProbability = 1e-4;
+    opt.maxSpawnCells  = 6;
+    opt.fourSpawnPlies = 1;
+    opt.threadCount = showcase ? ShowcaseThreads : 1;
+    Direction d = searchMove(a.next, a.weights, opt);
+
+    bool moved = false;
+    switch (d) {
+    case Direction::Left:  moved = a.next.moveLeft();  break;
+    case Direction::Right: moved = a.next.moveRight(); break;
+    case Direction::Up:    moved = a.next.moveUp();    break;
+    case Direction::Down:  moved = a.next.moveDown();  break;
+    }
+
+    if (moved) {
+        ++a.steps;
+        a.changed = true;
+
+        int curScore = a.next.score();
+        if (curScore > a.bestScore) {
+            a.bestScore = curScore;
+            a.bestMoves = a.steps;
         }
     }
 }
 
 void PopulationWindow::nextGeneration()
 {
+    TRACE_SCOPE("PopulationWindow::nextGeneration");
     m_waitingNextGen = false;
+    finishStep();
 
-    int n = std::min<int>(Count, m_population.size());
+    int n = std::min<int>(m_agents.size(), m_population.size());
     for (int i = 0; i < n; ++i) {
         Individual& ind = m_population[i];
         const Agent& a  = m_agents[i];
@@ -216,5 +243,5 @@ void PopulationWindow::nextGeneration()
     ++m_generation;
     setPopulation(m_population, m_generation);
 
-    savePopulation(m_population, m_generation, SaveFileName);
+    m_checkpointer.submit(m_population, m_generation);
 }
@@ -1,49 +1,67 @@
 #pragma once
 
 #include <QWidget>
+#include <future>
 #include <vector>
 #include <memory>
 
 #include "game2048.h"
-#include "boardwidget.h"
 #include "ai2048.h"
+#include "checkpoint2048.h"
 
 class QTimer;
 class QLabel;
+class PopulationGrid;
 
 class PopulationWindow : public QWidget
 {
     Q_OBJECT
 public:
     explicit PopulationWindow(QWidget* parent = nullptr);
-    ~PopulationWindow() override = default;
+    ~PopulationWindow() override;
 
 private slots:
     void stepAll();
     void nextGeneration();
 
 private:
+    // `game` is what the grid draws and only changes on the GUI thread;
+    // the rest belongs to the step in flight, if there is one.
     struct Agent {
         std::unique_ptr<Game2048> game;
+        Game2048     next;
         Weights      weights;
-        BoardWidget* boardWidget = nullptr;
-        QLabel*      scoreLabel  = nullptr;
 
         int          steps       = 0;
         int          bestScore   = 0;
         int          bestMoves   = 0;
         bool         finished    = false;
+        bool         changed     = false;
     };
 
     void setPopulation(const Population& pop, int generation);
+    void updateCaption(int index, int score);
 
+    // Runs off the GUI thread: one move for every unfinished agent.
+    void stepAgents();
+    static void stepAgent(Agent& a, bool showcase);
+    // Waits for the step in flight and shows its boards.
+    void finishStep();
+
+    // Size of a fresh population; a saved one keeps its own size.
     static constexpr int Count = 40;
-    static constexpr int Rows  = 5;
-    static constexpr int Cols  = 8;
+
+    // Per-agent search budget. Agents step on a pool of threads; a tick
+    // that finds the last step still running is skipped.
+    static constexpr double AgentDeadlineMs = 0.5;
+    // Search threads of agent 0, the best elite of the last generation; the
+    // step pool gives up as many threads so no core is oversubscribed.
+    static constexpr int ShowcaseThreads = 4;
 
     static constexpr const char* SaveFileName = "population_state.txt";
 
     std::vector<Agent> m_agents;
+    PopulationGrid*    m_grid           = nullptr;
 
     QTimer*            m_stepTimer      = nullptr;
     QTimer*            m_gaTimer        = nullptr;
@@ -52,4 +70,7 @@ private:
     QLabel*            m_generationLabel = nullptr;
 
     bool               m_waitingNextGen = false;
+    std::future<void>  m_stepping;
+
+    Checkpointer       m_checkpointer{SaveFileName};
 };
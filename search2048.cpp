@@ -0,0 +1,515 @@
+#include "search2048.h"
+#include "affinity2048.h"
+#include "bitboard2048.h"
+#include "deltaeval2048.h"
+#include "tablebase2048.h"
+#include "trace2048.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+EvalCache::EvalCache(int shardCount)
+    : m_shardCount(std::max(1, shardCount))
+    , m_shards(new Shard[m_shardCount]) {
+}
+
+EvalCache::Shard& EvalCache::shardFor(std::uint64_t key) const {
+    // Packed boards differ mostly in the low nibbles; mix before picking.
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return m_shards[key % m_shardCount];
+}
+
+bool EvalCache::find(std::uint64_t key, int depth, double& outValue) const {
+    Shard& s = shardFor(key);
+    std::scoped_lock lock(s.m);
+    auto it = s.map.find(key);
+    if (it == s.map.end() || it->second.depth != depth) return false;
+    outValue = it->second.value;
+    return true;
+}
+
+void EvalCache::store(std::uint64_t key, int depth, double value) {
+    Shard& s = shardFor(key);
+    std::scoped_lock lock(s.m);
+    s.map[key] = Entry{depth, value};
+}
+
+void EvalCache::clear() {
+    for (int i = 0; i < m_shardCount; ++i) {
+        std::scoped_lock lock(m_shards[i].m);
+        m_shards[i].map.clear();
+    }
+}
+
+std::size_t EvalCache::size() const {
+    std::size_t total = 0;
+    for (int i = 0; i < m_shardCount; ++i) {
+        std::scoped_lock lock(m_shards[i].m);
+        total += m_shards[i].map.size();
+    }
+    return total;
+}
+
+namespace {
+
+const Direction kDirs[] = {
+    Direction::Left,
+    Direction::Right,
+    Direction::Up,
+    Direction::Down
+};
+
+// State shared by every task of one searchMove() call.
+struct SharedState {
+    const Weights& w;
+    bool           hasDeadline;
+    Clock::time_point deadline;
+    const std::atomic<bool>* cancel;
+    int            spareTasks;      // tasks allowed besides the calling thread
+    int            parallelPlies;
+    double         minProbability;
+    int            maxSpawnCells;
+    int            fourSpawnPlies;
+    EvalCache&     cache;
+    DeltaEvaluator evaluator;
+
+    std::atomic<bool>      aborted{false};
+    std::atomic<int>       activeTasks{0};
+    std::atomic<int>       peakTasks{0};     // most subtree tasks at once
+    std::atomic<long long> nodes{0};
+    std::atomic<long long> cacheHits{0};
+    std::atomic<long long> busyNs{0};
+    std::atomic<long long> prunedBranches{0};
+    std::atomic<long long> sampledOutCells{0};
+    std::atomic<long long> droppedFourSpawns{0};
+    std::atomic<bool>      hitHorizon{false};
+};
+
+// Per-task counters, folded into SharedState when the task ends so the hot
+// path never touches shared cache lines.
+struct SearchContext {
+    SharedState& s;
+    long long nodes     = 0;
+    long long cacheHits = 0;
+    long long waitNs    = 0;   // time spent blocked on child tasks
+    long long prunedBranches    = 0;
+    long long sampledOutCells   = 0;
+    long long droppedFourSpawns = 0;
+    bool      hitHorizon = false;
+    // Set when a probability cutoff shaped the subtree being searched, whose
+    // value then depends on the path that led to it.
+    bool      pruned     = false;
+
+    explicit SearchContext(SharedState& shared) : s(shared) {}
+
+    void flush(Clock::duration total) {
+        s.nodes     += nodes;
+        s.cacheHits += cacheHits;
+        s.busyNs    += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           total).count() - waitNs;
+        s.prunedBranches    += prunedBranches;
+        s.sampledOutCells   += sampledOutCells;
+        s.droppedFourSpawns += droppedFourSpawns;
+        if (hitHorizon) s.hitHorizon = true;
+    }
+};
+
+bool tryMove(Game2048& g, Direction dir) {
+    switch (dir) {
+    case Direction::Left:  return g.moveLeft();
+    case Direction::Right: return g.moveRight();
+    case Direction::Up:    return g.moveUp();
+    case Direction::Down:  return g.moveDown();
+    }
+    return false;
+}
+
+// Checking the clock on every node is measurable at these node rates.
+bool outOfTime(SearchContext& ctx) {
+    if ((ctx.nodes & 63) != 0) return false;
+    if (ctx.s.aborted.load(std::memory_order_relaxed)) return true;
+    if ((ctx.s.hasDeadline && Clock::now() >= ctx.s.deadline)
+        || (ctx.s.cancel && ctx.s.cancel->load(std::memory_order_relaxed))) {
+        ctx.s.aborted = true;
+        return true;
+    }
+    return false;
+}
+
+bool aborted(const SearchContext& ctx) {
+    return ctx.s.aborted.load(std::memory_order_relaxed);
+}
+
+bool acquireTask(SharedState& s) {
+    int cur = s.activeTasks.load();
+    while (cur < s.spareTasks) {
+        if (s.activeTasks.compare_exchange_weak(cur, cur + 1)) {
+            int peak = s.peakTasks.load();
+            while (peak < cur + 1 && !s.peakTasks.compare_exchange_weak(peak, cur + 1)) {}
+            return true;
+        }
+    }
+    return false;
+}
+
+// Subtrees shallower than this cost less than starting a thread.
+constexpr int kMinTaskDepth = 2;
+
+// Runs fn(ctx) on another thread when a slot is free and the subtree is deep
+// enough to pay for it, inline otherwise.
+// A task reports its pruned flag through *taskPruned, which the caller
+// reads after waitFor().
+template <typename Fn>
+std::future<double> spawnOrRun(SearchContext& ctx, int subtreeDepth, Fn fn,
+                               double& inlineOut, bool& ranInline, bool* taskPruned) {
+    if (subtreeDepth >= kMinTaskDepth && acquireTask(ctx.s)) {
+        ranInline = false;
+        SharedState* s = &ctx.s;
+        return std::async(std::launch::async, [s, fn, taskPruned]() {
+            const Clock::time_point start = Clock::now();
+            TRACE_SCOPE("searchMove: subtree task");
+            pinSimulationThread();
+            SearchContext local(*s);
+            double v = fn(local);
+            *taskPruned = local.pruned;
+            local.flush(Clock::now() - start);
+            --s->activeTasks;
+            return v;
+        });
+    }
+    ranInline = true;
+    inlineOut = fn(ctx);
+    return {};
+}
+
+double waitFor(SearchContext& ctx, std::future<double>& f) {
+    TRACE_SCOPE("searchMove: wait for subtree");
+    const Clock::time_point start = Clock::now();
+    double v = f.get();
+    ctx.waitNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      Clock::now() - start).count();
+    return v;
+}
+
+double chanceNode(const Game2048& after, int depth, int ply, double prob, SearchContext& ctx);
+
+// Boards the last ply can handle packed: a move then still fits a nibble.
+bool packable(const Game2048& g) {
+    return g.size() <= 4 && g.maxTile() < 32768;
+}
+
+// maxNode() on the last ply, where every afterstate is a leaf. The moves
+// are played on the packed board and each afterstate rescans only the
+// lines it changed.
+double leafMaxNode(const DeltaEvaluator::State& s, SearchContext& ctx) {
+    ++ctx.nodes;
+    if (outOfTime(ctx)) return 0.0;
+
+    double best = 0.0;
+    int count = 0;
+    for (int d = 0; d < 4; ++d) {
+        Board64 after;
+        if (!moveBoard(s.board, d, after, s.n)) continue;
+        const double v = ctx.s.evaluator.child(s, after).score;
+        if (count++ == 0 || v > best) best = v;
+    }
+    if (count == 0) return s.score;
+
+    ctx.nodes += count;
+    ctx.hitHorizon = true;
+    return best;
+}
+
+double maxNode(const Game2048& g, int depth, int ply, double prob, SearchContext& ctx) {
+    if (depth <= 1 && packable(g)) {
+        Board64 b;
+        packBoard(g, b);
+        return leafMaxNode(ctx.s.evaluator.evaluate(b, g.size()), ctx);
+    }
+
+    ++ctx.nodes;
+    if (outOfTime(ctx)) return 0.0;
+
+    double best = -1e100;
+    bool anyMove = false;
+
+    for (Direction d : kDirs) {
+        Game2048 tmp = g;
+        tmp.setAutoSpawn(false);
+        if (!tryMove(tmp, d)) continue;
+
+        anyMove = true;
+        double v = chanceNode(tmp, depth, ply, prob, ctx);
+        if (aborted(ctx)) return 0.0;
+        if (v > best) best = v;
+    }
+
+    return anyMove ? best : evaluateBoard(g, ctx.s.w);
+}
+
+std::uint64_t splitmix64(std::uint64_t& state) {
+    std::uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+double expandSpawns(const Game2048& after, int depth, int ply, double prob, SearchContext& ctx) {
+    const int n = after.size();
+    const bool parallel = ply < ctx.s.parallelPlies && ctx.s.spareTasks > 0;
+    const bool withFours = ctx.s.fourSpawnPlies < 0 || ply < ctx.s.fourSpawnPlies;
+
+    std::uint64_t mask = after.emptyMask();
+    if (mask == 0) return evaluateBoard(after, ctx.s.w);
+
+    // Scratch lives on the stack; the cache and, on parallel plies, the
+    // futures still allocate.
+    constexpr int kMaxCells = Game2048::MaxSize * Game2048::MaxSize;
+    std::pair<int,int> cells[kMaxCells];
+    int cellCount = 0;
+    for (int i = 0; mask != 0; ++i, mask >>= 1) {
+        if (mask & 1) cells[cellCount++] = {i / n, i % n};
+    }
+
+    // Each spawn's true path probability, even when only a sample is expanded.
+    const double cellProb = prob / cellCount;
+
+    // A partial shuffle seeded by the board keeps the sample, and with it the
+    // search result, reproducible for a given position.
+    const int limit = ctx.s.maxSpawnCells;
+    if (limit > 0 && cellCount > limit) {
+        std::uint64_t state = 0;
+        for (int r = 0; r < n; ++r)
+            for (int c = 0; c < n; ++c) state = state * 31 + after.at(r, c);
+        for (int i = 0; i < limit; ++i) {
+            int j = i + int(splitmix64(state) % std::uint64_t(cellCount - i));
+            std::swap(cells[i], cells[j]);
+        }
+        ctx.sampledOutCells += (long long)cellCount - limit;
+        cellCount = limit;
+        std::sort(cells, cells + cellCount);
+    }
+    if (!withFours) ctx.droppedFourSpawns += (long long)cellCount;
+
+    // Values are summed in cell order at the end so the result does not
+    // depend on which subtrees ran as tasks.
+    double v2[kMaxCells] = {};
+    double v4[kMaxCells] = {};
+
+    // Children on the last ply are leaves: each spawn updates the packed
+    // afterstate's cached lines in place of copying the game.
+    if (depth - 1 <= 1 && packable(after)) {
+        Board64 b;
+        packBoard(after, b);
+        const DeltaEvaluator::State base = ctx.s.evaluator.evaluate(b, n);
+        double total = 0.0;
+        for (int i = 0; i < cellCount && !aborted(ctx); ++i) {
+            const int cell = cells[i].first * n + cells[i].second;
+            v2[i] = leafMaxNode(ctx.s.evaluator.spawn(base, cell, 1), ctx);
+            if (aborted(ctx) || !withFours) continue;
+            v4[i] = leafMaxNode(ctx.s.evaluator.spawn(base, cell, 2), ctx);
+        }
+        for (int i = 0; i < cellCount; ++i)
+            total += withFours ? 0.9 * v2[i] + 0.1 * v4[i] : v2[i];
+        if (aborted(ctx)) return 0.0;
+        return total / cellCount;
+    }
+
+    std::vector<std::future<double>> pending;
+    bool taskPruned[kMaxCells] = {};
+    if (parallel) pending.resize(cellCount);
+
+    for (int i = 0; i < cellCount && !aborted(ctx); ++i) {
+        const auto [r, c] = cells[i];
+
+        // Without fours the 2-spawn stands for the whole cell.
+        const double p2 = withFours ? cellProb * 0.9 : cellProb;
+        const double p4 = cellProb * 0.1;
+
+        Game2048 child = after;
+        child.setTile(r, c, 2);
+        if (parallel) {
+            bool ranInline = true;
+            pending[i] = spawnOrRun(ctx, depth - 1, [child, depth, ply, p2](SearchContext& c2) {
+                return maxNode(child, depth - 1, ply + 1, p2, c2);
+            }, v2[i], ranInline, &taskPruned[i]);
+        } else {
+            v2[i] = maxNode(child, depth - 1, ply + 1, p2, ctx);
+        }
+        if (aborted(ctx) || !withFours) continue;
+
+        child.setTile(r, c, 4);
+        v4[i] = maxNode(child, depth - 1, ply + 1, p4, ctx);
+    }
+
+    double total = 0.0;
+    for (int i = 0; i < cellCount; ++i) {
+        if (parallel && pending[i].valid()) {
+            v2[i] = waitFor(ctx, pending[i]);
+            if (taskPruned[i]) ctx.pruned = true;
+        }
+        total += withFours ? 0.9 * v2[i] + 0.1 * v4[i] : v2[i];
+    }
+
+    if (aborted(ctx)) return 0.0;
+    return total / cellCount;
+}
+
+// A subtree's value depends on the board, the depth and, when 4-spawns stop
+// after fourSpawnPlies, on how many of its plies still have them; the cache
+// entry is tagged with both. Subtrees cut by minProbability also depend on
+// the path probability and are not stored, so a cached value is the same
+// whichever path or task computed it first.
+int cacheTag(int depth, int ply, const SharedState& s) {
+    const int fourPlies = (s.fourSpawnPlies < 0)
+        ? depth : std::clamp(s.fourSpawnPlies - ply, 0, depth);
+    return depth * 64 + fourPlies;
+}
+
+double chanceNode(const Game2048& after, int depth, int ply, double prob, SearchContext& ctx) {
+    ++ctx.nodes;
+    if (outOfTime(ctx)) return 0.0;
+    if (depth <= 1) {
+        ctx.hitHorizon = true;
+        return evaluateBoard(after, ctx.s.w);
+    }
+    if (prob < ctx.s.minProbability) {
+        ++ctx.prunedBranches;
+        ctx.hitHorizon = true;
+        ctx.pruned = true;
+        return evaluateBoard(after, ctx.s.w);
+    }
+
+    Board64 key = 0;
+    const bool cacheable = packBoard(after, key);
+    const int tag = cacheTag(depth, ply, ctx.s);
+    double v = 0.0;
+    if (cacheable && ctx.s.cache.find(key, tag, v)) {
+        ++ctx.cacheHits;
+        // The cached subtree may have been cut by the horizon too.
+        ctx.hitHorizon = true;
+        return v;
+    }
+
+    const bool outerPruned = ctx.pruned;
+    ctx.pruned = false;
+    v = expandSpawns(after, depth, ply, prob, ctx);
+    if (cacheable && !ctx.pruned && !aborted(ctx)) ctx.s.cache.store(key, tag, v);
+    ctx.pruned = ctx.pruned || outerPruned;
+    return v;
+}
+
+} // namespace
+
+Direction searchMove(const Game2048& game, const Weights& w,
+                     const SearchOptions& opt, SearchStats* outStats)
+{
+    TRACE_SCOPE("searchMove");
+    const Clock::time_point start = Clock::now();
+
+    Direction tbDir;
+    if (opt.tablebase && opt.tablebase->bestMove(game, tbDir)) {
+        if (outStats) {
+            *outStats = SearchStats();
+            outStats->fromTablebase = true;
+            outStats->elapsedMs = std::chrono::duration<double, std::milli>(
+                Clock::now() - start).count();
+        }
+        return tbDir;
+    }
+
+    const int threads = (opt.threadCount > 0)
+        ? opt.threadCount
+        : std::max(1u, std::thread::hardware_concurrency());
+
+    EvalCache privateCache;
+    SharedState shared{w, opt.deadlineMs > 0.0, {}, opt.cancel, threads - 1,
+                       opt.parallelPlies, opt.minProbability, opt.maxSpawnCells,
+                       opt.fourSpawnPlies,
+                       opt.cache ? *opt.cache : privateCache, DeltaEvaluator(w)};
+    if (shared.hasDeadline) {
+        shared.deadline = start + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double, std::milli>(opt.deadlineMs));
+    }
+
+    SearchContext ctx(shared);
+
+    // The greedy move is the fallback if not even depth 1 finishes.
+    Direction bestDir = chooseMove(game, w);
+    int depthReached = 0;
+
+    const int maxDepth = (opt.maxDepth > 0) ? opt.maxDepth
+        : (shared.hasDeadline ? DeadlineSearchDepth : OfflineSearchDepth);
+    for (int depth = 1; depth <= maxDepth; ++depth) {
+        shared.hitHorizon = false;
+        ctx.hitHorizon = false;
+
+        struct RootMove {
+            Direction dir;
+            double value = 0.0;
+            bool ranInline = true;
+            bool pruned = false;
+            std::future<double> pending;
+        };
+        std::vector<RootMove> roots;
+        roots.reserve(4);
+
+        for (Direction d : kDirs) {
+            Game2048 tmp = game;
+            tmp.setAutoSpawn(false);
+            if (!tryMove(tmp, d)) continue;
+
+            roots.push_back(RootMove{d, 0.0, true, false, {}});
+            RootMove& rm = roots.back();
+            rm.pending = spawnOrRun(ctx, depth, [tmp, depth](SearchContext& c2) {
+                return chanceNode(tmp, depth, 0, 1.0, c2);
+            }, rm.value, rm.ranInline, &rm.pruned);
+            if (aborted(ctx)) break;
+        }
+
+        for (auto& rm : roots) {
+            if (!rm.ranInline) rm.value = waitFor(ctx, rm.pending);
+        }
+
+        if (aborted(ctx) || roots.empty()) break;
+
+        double iterBest = -1e100;
+        for (const auto& rm : roots) {
+            if (rm.value > iterBest) {
+                iterBest = rm.value;
+                bestDir = rm.dir;
+            }
+        }
+        depthReached = depth;
+
+        // Every line ended in a terminal position; deeper is identical.
+        if (!ctx.hitHorizon && !shared.hitHorizon) break;
+    }
+
+    const Clock::duration elapsed = Clock::now() - start;
+    ctx.flush(elapsed);
+
+    if (outStats) {
+        outStats->depthReached = depthReached;
+        outStats->nodes        = shared.nodes;
+        outStats->cacheHits    = shared.cacheHits;
+        outStats->elapsedMs    = std::chrono::duration<double, std::milli>(elapsed).count();
+        outStats->prunedBranches    = shared.prunedBranches;
+        outStats->sampledOutCells   = shared.sampledOutCells;
+        outStats->droppedFourSpawns = shared.droppedFourSpawns;
+        outStats->threadsUsed  = 1 + shared.peakTasks;
+        outStats->busyMs       = shared.busyNs / 1e6;
+        outStats->efficiency   = (outStats->elapsedMs > 0.0)
+            ? outStats->busyMs / (outStats->elapsedMs * outStats->threadsUsed)
+            : 1.0;
+    }
+
+    return bestDir;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "ai2048.h"
+
+class Tablebase;
+
+// Thread-safe cache of chance-node values keyed by the packed afterstate.
+// An entry is only meaningful for the Weights it was computed with, so a
+// cache must not be shared between searches with different weights. The
+// depth argument only has to match exactly; searchMove() also folds its
+// pruning settings into it.
+class EvalCache {
+public:
+    explicit EvalCache(int shardCount = 64);
+
+    bool find(std::uint64_t key, int depth, double& outValue) const;
+    void store(std::uint64_t key, int depth, double value);
+    void clear();
+    std::size_t size() const;
+
+private:
+    struct Entry {
+        int    depth;
+        double value;
+    };
+    struct Shard {
+        mutable std::mutex m;
+        std::unordered_map<std::uint64_t, Entry> map;
+    };
+
+    Shard& shardFor(std::uint64_t key) const;
+
+    int m_shardCount;
+    std::unique_ptr<Shard[]> m_shards;
+};
+
+// Expectimax search over player moves and tile spawns. Depth counts player
+// moves: depth 1 scores each afterstate directly, depth 2 also averages over
+// the spawn and the reply, and so on.
+//
+// The search is anytime: it deepens one ply at a time and stops when the
+// deadline expires, returning the move found by the deepest iteration that
+// completed. With deadlineMs <= 0 it simply searches to maxDepth, which is
+// what offline batch play wants; there the default depth is
+// OfflineSearchDepth, since every extra ply multiplies the work.
+//
+// With more than one thread the root moves, and the 2-spawn subtrees of the
+// top parallelPlies chance levels, run as separate tasks.
+//
+// Chance nodes can be thinned out to afford more depth: a branch whose
+// cumulative spawn probability falls below minProbability is scored as a
+// leaf, boards with more than maxSpawnCells empties expand only a sample of
+// them, and below fourSpawnPlies chance levels only 2-spawns are considered.
+// All three are off by default.
+constexpr int DeadlineSearchDepth = 16;
+constexpr int OfflineSearchDepth  = 3;
+
+struct SearchOptions {
+    // 0 = DeadlineSearchDepth with a deadline, OfflineSearchDepth without.
+    int    maxDepth      = 0;
+    double deadlineMs    = 5.0;
+    int    threadCount   = 1;         // 0 = all hardware threads
+    int    parallelPlies = 1;
+    EvalCache* cache     = nullptr;   // nullptr = private cache per call
+
+    // Positions the tablebase covers are played from it directly.
+    const Tablebase* tablebase = nullptr;
+
+    double minProbability = 0.0;
+    int    maxSpawnCells  = 0;        // 0 = expand every empty cell
+    int    fourSpawnPlies = -1;       // -1 = 4-spawns at every level
+
+    // Setting *cancel stops the search as if its deadline had passed.
+    const std::atomic<bool>* cancel = nullptr;
+};
+
+struct SearchStats {
+    int       depthReached = 0;   // deepest fully completed iteration
+    bool      fromTablebase = false;
+    long long nodes        = 0;   // all nodes visited, aborted iteration included
+    long long cacheHits    = 0;
+    double    elapsedMs    = 0.0;
+
+    // Chance-node children that pruning did not expand.
+    long long prunedBranches    = 0;
+    long long sampledOutCells   = 0;
+    long long droppedFourSpawns = 0;
+
+    // busyMs sums the time every task spent searching, so busyMs / elapsedMs
+    // estimates the speedup and dividing by threadsUsed gives efficiency.
+    // threadsUsed counts the calling thread and the most subtree tasks that
+    // ran at once, which shallow searches keep below threadCount.
+    int       threadsUsed  = 1;
+    double    busyMs       = 0.0;
+    double    efficiency   = 1.0;
+};
+
+Direction searchMove(const Game2048& game,
+                     const Weights& w,
+                     const SearchOptions& opt = SearchOptions(),
+                     SearchStats* outStats = nullptr);
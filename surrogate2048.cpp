@@ -0,0 +1,139 @@
+#include "surrogate2048.h"
+#include "genometable2048.h"
+#include "trace2048.h"
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+
+static double geneScale(int i)
+{
+    const double range = Genes[i].randomMax - Genes[i].randomMin;
+    if (range > 0.0) return range;
+    return Genes[i].mutationStep > 0.0 ? Genes[i].mutationStep : 1.0;
+}
+
+static void scaleGenes(const Weights& w, double* out)
+{
+    for (int i = 0; i < GeneCount; ++i) out[i] = w[i] / geneScale(i);
+}
+
+FitnessSurrogate::FitnessSurrogate(int neighbours, std::size_t capacity)
+    : m_neighbours(std::max(1, neighbours))
+    , m_capacity(std::max<std::size_t>(1, capacity))
+{
+}
+
+double FitnessSurrogate::distance(const double* scaled, std::size_t row) const
+{
+    const double* g = &m_genes[row * GeneCount];
+    double d = 0.0;
+    for (int i = 0; i < GeneCount; ++i) {
+        const double diff = scaled[i] - g[i];
+        d += diff * diff;
+    }
+    return d;
+}
+
+void FitnessSurrogate::observe(const Weights& w, double meanScore, double msPerMove)
+{
+    double scaled[GeneCount];
+    scaleGenes(w, scaled);
+
+    std::size_t row = 0;
+    while (row < size() && distance(scaled, row) != 0.0) ++row;
+
+    if (row == size()) {
+        if (size() < m_capacity) {
+            m_score.push_back(0.0);
+            m_msPerMove.push_back(0.0);
+            m_genes.resize(m_genes.size() + GeneCount);
+        } else {
+            row = m_next;
+            m_next = (m_next + 1) % m_capacity;
+        }
+        std::copy(scaled, scaled + GeneCount, &m_genes[row * GeneCount]);
+    }
+    m_score[row]     = meanScore;
+    m_msPerMove[row] = msPerMove;
+}
+
+void FitnessSurrogate::observe(const Population& pop)
+{
+    for (const Individual& ind : pop) observe(ind.w, ind.fitness, ind.msPerMove);
+}
+
+double FitnessSurrogate::predict(const Weights& w, double* msPerMove) const
+{
+    if (msPerMove) *msPerMove = 0.0;
+    if (size() == 0) return 0.0;
+
+    double scaled[GeneCount];
+    scaleGenes(w, scaled);
+
+    std::vector<std::pair<double, std::size_t>> nearest(size());
+    for (std::size_t row = 0; row < size(); ++row)
+        nearest[row] = {distance(scaled, row), row};
+
+    const std::size_t k = std::min(size(), std::size_t(m_neighbours));
+    std::partial_sort(nearest.begin(), nearest.begin() + k, nearest.end());
+    if (nearest[0].first == 0.0) {
+        if (msPerMove) *msPerMove = m_msPerMove[nearest[0].second];
+        return m_score[nearest[0].second];
+    }
+
+    double score = 0.0, ms = 0.0, weights = 0.0;
+    for (std::size_t i = 0; i < k; ++i) {
+        const double weight = 1.0 / nearest[i].first;
+        score += weight * m_score[nearest[i].second];
+        ms    += weight * m_msPerMove[nearest[i].second];
+        weights += weight;
+    }
+    if (msPerMove) *msPerMove = ms / weights;
+    return score / weights;
+}
+
+Population evolveScreened(const Population& pop, const FitnessSurrogate& surrogate,
+                          const CostModel& cost, double eliteRate, double mutationRate, int oversample,
+                          int* outScreened)
+{
+    TRACE_SCOPE("evolveScreened");
+    if (outScreened) *outScreened = 0;
+    if (oversample <= 1 || !surrogate.ready() || pop.empty())
+        return evolve(pop, eliteRate, mutationRate);
+
+    thread_local std::mt19937_64 gen(std::random_device{}());
+    GenomeTable bred;
+    const std::size_t elites = evolveTable(GenomeTable(pop), bred, eliteRate, mutationRate,
+                                           gen(), 0, pop.size() * std::size_t(oversample));
+    const std::size_t keep = pop.size() - elites;
+
+    // Children scored as if they had been played, then ranked by the cost
+    // model like a real generation. Best first; ties keep breeding order so
+    // the result only depends on the seed.
+    Population predicted(bred.size() - elites);
+    for (std::size_t i = 0; i < predicted.size(); ++i)
+        predicted[i].fitness = surrogate.predict(bred.weights(elites + i),
+                                                 &predicted[i].msPerMove);
+    applyCostModel(predicted, cost);
+    std::vector<std::size_t> order(predicted.size());
+    std::iota(order.begin(), order.end(), std::size_t(0));
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        return predicted[a].fitness > predicted[b].fitness;
+    });
+
+    Population next(elites);
+    for (std::size_t e = 0; e < elites; ++e) {
+        next[e].w         = bred.weights(e);
+        next[e].fitness   = bred.fitness[e];
+        next[e].bestScore = bred.bestScore[e];
+        next[e].bestMoves = bred.bestMoves[e];
+    }
+    for (std::size_t i = 0; i < keep; ++i) {
+        Individual child;
+        child.w = bred.weights(elites + order[i]);
+        next.push_back(child);
+    }
+    if (outScreened) *outScreened = int(order.size() - keep);
+    return next;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "ai2048.h"
+
+// A cheap stand-in for evaluateFitness(), used to decide which children
+// are worth playing at all.
+//
+// The surrogate remembers the genes, mean score and ms/move of individuals
+// that were actually evaluated and predicts a new genome's from its nearest
+// neighbours. It learns raw measurements, not cost-adjusted fitness, so a
+// cost model (whose Pareto ranks mean nothing outside their generation) is
+// applied to the predictions instead. Distances are taken over genes
+// scaled by their random range, so no single gene dominates.
+class FitnessSurrogate {
+public:
+    explicit FitnessSurrogate(int neighbours = 8, std::size_t capacity = 4096);
+
+    // Records a measurement. Observing the same weights again replaces the
+    // old one; beyond capacity the oldest observation is forgotten.
+    void observe(const Weights& w, double meanScore, double msPerMove);
+    // Takes fitness as the mean score, so call it before applyCostModel().
+    void observe(const Population& pop);
+
+    std::size_t size() const { return m_score.size(); }
+    bool ready() const { return size() >= std::size_t(m_neighbours); }
+
+    // Inverse-distance weighted mean score of the nearest observations,
+    // and their ms/move if msPerMove is given; exact for observed weights.
+    // 0 if nothing has been observed.
+    double predict(const Weights& w, double* msPerMove = nullptr) const;
+
+private:
+    double distance(const double* scaled, std::size_t row) const;
+
+    int                 m_neighbours;
+    std::size_t         m_capacity;
+    std::size_t         m_next = 0;
+    std::vector<double> m_genes;     // size() rows of GeneCount scaled genes
+    std::vector<double> m_score;
+    std::vector<double> m_msPerMove;
+};
+
+// Like evolve(), but breeds oversample times as many children as the next
+// generation needs and keeps the ones whose predictions rank highest under
+// cost; elites pass unscreened. Falls back to evolve() until the surrogate
+// is ready. outScreened, if given, receives the number of children
+// discarded.
+Population evolveScreened(const Population& pop,
+                          const FitnessSurrogate& surrogate,
+                          const CostModel& cost = {},
+                          double eliteRate = 0.1,
+                          double mutationRate = 0.1,
+                          int oversample = 4,
+                          int* outScreened = nullptr);
@@ -0,0 +1,415 @@
+#include "sweep2048.h"
+#include "affinity2048.h"
+#include "checkpoint2048.h"
+#include "trace2048.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+static bool parseList(const std::string& text, std::vector<double>& out)
+{
+    std::istringstream is(text);
+    std::string item;
+    while (std::getline(is, item, ',')) {
+        std::istringstream vs(item);
+        double v;
+        if (!(vs >> v) || !(vs >> std::ws).eof()) return false;
+        out.push_back(v);
+    }
+    return !out.empty();
+}
+
+static std::vector<SweepConfig> randomSweep(int count)
+{
+    std::mt19937 gen(std::random_device{}());
+    auto uniform = [&](double lo, double hi) {
+        return std::uniform_real_distribution<double>(lo, hi)(gen);
+    };
+
+    std::vector<SweepConfig> configs(count);
+    for (SweepConfig& c : configs) {
+        c.populationSize = int(uniform(10, 101));
+        c.eliteRate      = uniform(0.02, 0.3);
+        c.mutationRate   = uniform(0.02, 0.5);
+        c.games          = int(uniform(3, 21));
+        c.maxMoves       = int(uniform(5, 51)) * 100;
+    }
+    return configs;
+}
+
+bool parseSweepSpec(const std::string& spec, std::vector<SweepConfig>& out, std::string* error)
+{
+    out.clear();
+    if (spec.compare(0, 7, "random:") == 0) {
+        const int count = std::atoi(spec.c_str() + 7);
+        if (count <= 0) {
+            if (error) *error = "bad sweep size in '" + spec + "'";
+            return false;
+        }
+        out = randomSweep(count);
+        return true;
+    }
+
+    out.push_back(SweepConfig());
+    std::istringstream is(spec);
+    std::string entry;
+    while (std::getline(is, entry, ';')) {
+        if (entry.empty()) continue;
+        const auto eq = entry.find('=');
+        const std::string key = entry.substr(0, eq);
+        std::vector<double> values;
+        if (eq == std::string::npos || !parseList(entry.substr(eq + 1), values)) {
+            if (error) *error = "bad sweep entry '" + entry + "'";
+            return false;
+        }
+
+        std::vector<SweepConfig> expanded;
+        for (const SweepConfig& base : out) {
+            for (double v : values) {
+                SweepConfig c = base;
+                bool ok = true;
+                if (key == "population")    ok = (c.populationSize = int(v)) >= 1;
+                else if (key == "elite")    ok = (c.eliteRate = v) >= 0.0 && v <= 1.0;
+                else if (key == "mutation") ok = (c.mutationRate = v) >= 0.0 && v <= 1.0;
+                else if (key == "games")    ok = (c.games = int(v)) >= 1;
+                else if (key == "maxMoves") ok = (c.maxMoves = int(v)) >= 1;
+                else {
+                    if (error) *error = "unknown sweep parameter '" + key + "'";
+                    return false;
+                }
+                if (!ok) {
+                    if (error) *error = "bad value in sweep entry '" + entry + "'";
+                    return false;
+                }
+                expanded.push_back(c);
+            }
+        }
+        out = std::move(expanded);
+    }
+    return true;
+}
+
+const char* sweepStatusName(SweepResult::Status status)
+{
+    switch (status) {
+    case SweepResult::Status::Finished: return "finished";
+    case SweepResult::Status::Behind:   return "behind";
+    case SweepResult::Status::Stalled:  return "stalled";
+    }
+    return "?";
+}
+
+namespace {
+
+struct Benchmark {
+    int                 generation = 0;
+    Weights             w;
+    std::vector<double> scores;
+    int                 next    = 0;
+    int                 pending = 0;
+};
+
+struct Run {
+    SweepResult result;
+    Population  pop;
+    std::uint32_t seedBase = 0;      // of the generation being evaluated
+    std::size_t nextIndividual = 0;
+    int  pendingIndividuals = 0;
+    bool evaluating = true;          // false once the last generation is in
+    bool ended      = false;
+    int  inFlight   = 0;
+    long long jobsDone = 0;
+
+    std::deque<Benchmark> benchmarks;   // oldest first
+    std::vector<double> bestByGeneration;
+    int sinceImprovement = 0;
+
+    bool hasJob() const {
+        if (ended) return false;
+        for (const Benchmark& b : benchmarks)
+            if (b.next < int(b.scores.size())) return true;
+        return evaluating && nextIndividual < pop.size();
+    }
+
+    // CPU time used, counting jobs in flight at the average job cost.
+    double charged() const {
+        const double perJob = jobsDone > 0 ? result.cpuSeconds / double(jobsDone) : 0.0;
+        return result.cpuSeconds + inFlight * perJob;
+    }
+};
+
+struct Job {
+    int run = -1;
+    int generation = 0;
+    int individual = -1;   // -1 for a benchmark game
+    int game = 0;
+    Weights w;
+};
+
+class Sweep {
+public:
+    Sweep(const std::vector<SweepConfig>& configs, const SweepOptions& options,
+          const std::function<void(const SweepResult&)>& onRunEnd)
+        : m_options(options), m_onRunEnd(onRunEnd), m_runs(configs.size())
+    {
+        for (std::size_t r = 0; r < configs.size(); ++r) {
+            Run& run = m_runs[r];
+            run.result.config = configs[r];
+            run.pop = createInitialPopulation(std::max(1, configs[r].populationSize));
+            startGeneration(int(r));
+            if (m_options.generations <= 0) end(run, SweepResult::Status::Finished);
+        }
+    }
+
+    void work();
+
+    std::vector<SweepResult> results() const {
+        std::vector<SweepResult> out;
+        for (const Run& run : m_runs) out.push_back(run.result);
+        return out;
+    }
+
+private:
+    bool allEnded() const {
+        return std::all_of(m_runs.begin(), m_runs.end(), [](const Run& r) { return r.ended; });
+    }
+
+    void startGeneration(int r);
+    bool takeJob(Job& job);
+    void finishGeneration(int r);
+    void finishBenchmark(int r, const Benchmark& b);
+    void end(Run& run, SweepResult::Status status);
+
+    const SweepOptions m_options;
+    const std::function<void(const SweepResult&)>& m_onRunEnd;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<Run> m_runs;
+};
+
+void Sweep::startGeneration(int r)
+{
+    Run& run = m_runs[r];
+    run.seedBase = (std::uint32_t(r) * 7919u + std::uint32_t(run.result.generations)) * 1000003u;
+    run.nextIndividual = 0;
+    run.pendingIndividuals = int(run.pop.size());
+}
+
+// The cheapest run so far gets the thread. Benchmarks go first, so that
+// stop decisions are not held up behind the next generation.
+bool Sweep::takeJob(Job& job)
+{
+    int pick = -1;
+    for (int r = 0; r < int(m_runs.size()); ++r) {
+        if (!m_runs[r].hasJob()) continue;
+        if (pick < 0 || m_runs[r].charged() < m_runs[pick].charged()) pick = r;
+    }
+    if (pick < 0) return false;
+
+    Run& run = m_runs[pick];
+    job = Job();
+    job.run = pick;
+    ++run.inFlight;
+    for (Benchmark& b : run.benchmarks) {
+        if (b.next < int(b.scores.size())) {
+            job.generation = b.generation;
+            job.game = b.next++;
+            job.w = b.w;
+            return true;
+        }
+    }
+    job.generation = run.result.generations;
+    job.individual = int(run.nextIndividual++);
+    job.w = run.pop[job.individual].w;
+    return true;
+}
+
+void Sweep::finishGeneration(int r)
+{
+    Run& run = m_runs[r];
+    const Individual& champion = *std::max_element(run.pop.begin(), run.pop.end(),
+        [](const Individual& x, const Individual& y) { return x.fitness < y.fitness; });
+    run.result.bestFitness = std::max(run.result.bestFitness, champion.fitness);
+
+    Benchmark b;
+    b.generation = run.result.generations;
+    b.w = champion.w;
+    b.scores.assign(std::size_t(std::max(1, m_options.benchmark.games)), 0.0);
+    b.pending = int(b.scores.size());
+    run.benchmarks.push_back(std::move(b));
+
+    ++run.result.generations;
+    if (run.result.generations >= m_options.generations) {
+        run.evaluating = false;
+        return;
+    }
+    run.pop = evolve(run.pop, run.result.config.eliteRate, run.result.config.mutationRate);
+    startGeneration(r);
+}
+
+void Sweep::finishBenchmark(int r, const Benchmark& b)
+{
+    Run& run = m_runs[r];
+    SweepResult& result = run.result;
+
+    double sum = 0.0;
+    for (double s : b.scores) sum += s;
+    const double mean = sum / double(b.scores.size());
+
+    result.finalBenchmark = mean;
+    if (run.bestByGeneration.empty() || mean > result.bestBenchmark) {
+        result.bestBenchmark = mean;
+        result.bestWeights = b.w;
+        run.sinceImprovement = 0;
+    } else {
+        ++run.sinceImprovement;
+    }
+    run.bestByGeneration.push_back(result.bestBenchmark);
+
+    const std::size_t done = run.bestByGeneration.size();
+    if (int(done) >= m_options.generations) {
+        end(run, SweepResult::Status::Finished);
+        return;
+    }
+    if (int(done) < m_options.minGenerations) return;
+
+    double leader = 0.0;
+    for (const Run& other : m_runs) {
+        if (other.bestByGeneration.size() >= done)
+            leader = std::max(leader, other.bestByGeneration[done - 1]);
+    }
+    if (result.bestBenchmark < m_options.behindFraction * leader)
+        end(run, SweepResult::Status::Behind);
+    else if (run.sinceImprovement >= m_options.patience)
+        end(run, SweepResult::Status::Stalled);
+}
+
+void Sweep::end(Run& run, SweepResult::Status status)
+{
+    if (run.ended) return;
+    run.ended = true;
+    run.result.status = status;
+    // A stopped run reports the generations it got a benchmark for.
+    run.result.generations = int(run.bestByGeneration.size());
+    run.benchmarks.clear();
+    run.pop.clear();
+    if (m_onRunEnd) m_onRunEnd(run.result);
+}
+
+void Sweep::work()
+{
+    using Clock = std::chrono::steady_clock;
+    pinSimulationThread();
+
+    std::unique_lock lock(m_mutex);
+    for (;;) {
+        Job job;
+        m_cv.wait(lock, [&] { return allEnded() || takeJob(job); });
+        if (job.run < 0) return;
+
+        const SweepConfig config = m_runs[job.run].result.config;
+        const std::uint32_t seedBase = m_runs[job.run].seedBase;
+        lock.unlock();
+
+        Individual ind;
+        FitnessCost cost;
+        double score = 0.0;
+        if (job.individual >= 0) {
+            TRACE_SCOPE("sweep: fitness");
+            // One thread: the games stay on this pinned pool thread.
+            ind.fitness = evaluateFitnessSeeded(job.w, seedBase, config.games, config.maxMoves,
+                                                ind.bestScore, ind.bestMoves, 1, &cost);
+        } else {
+            TRACE_SCOPE("sweep: benchmark");
+            const Clock::time_point start = Clock::now();
+            score = playSeededGame(job.w, m_options.benchmark.seedBase + std::uint32_t(job.game),
+                                   m_options.benchmark.maxMoves);
+            cost.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        lock.lock();
+        Run& run = m_runs[job.run];
+        --run.inFlight;
+        ++run.jobsDone;
+        run.result.cpuSeconds += cost.seconds;
+        run.result.gamesPlayed += (job.individual >= 0) ? config.games : 1;
+
+        if (!run.ended && job.individual >= 0) {
+            Individual& dst = run.pop[job.individual];
+            dst.fitness   = ind.fitness;
+            dst.bestScore = ind.bestScore;
+            dst.bestMoves = ind.bestMoves;
+            dst.msPerMove = cost.msPerMove();
+            if (--run.pendingIndividuals == 0) finishGeneration(job.run);
+        } else if (!run.ended) {
+            for (Benchmark& b : run.benchmarks) {
+                if (b.generation != job.generation) continue;
+                b.scores[job.game] = score;
+                --b.pending;
+                break;
+            }
+            // Generations are judged in order, whichever finishes first.
+            while (!run.ended && !run.benchmarks.empty() && run.benchmarks.front().pending == 0) {
+                const Benchmark b = std::move(run.benchmarks.front());
+                run.benchmarks.pop_front();
+                finishBenchmark(job.run, b);
+            }
+        }
+        m_cv.notify_all();
+    }
+}
+
+} // namespace
+
+std::vector<SweepResult> runSweep(const std::vector<SweepConfig>& configs,
+                                  const SweepOptions& options,
+                                  const std::function<void(const SweepResult&)>& onRunEnd)
+{
+    TRACE_SCOPE("runSweep");
+    Sweep sweep(configs, options, onRunEnd);
+
+    const int threads = (options.threadCount > 0)
+        ? options.threadCount
+        : int(std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::future<void>> futures;
+    for (int t = 1; t < threads; ++t)
+        futures.emplace_back(std::async(std::launch::async, &Sweep::work, &sweep));
+    sweep.work();
+    for (auto& f : futures) f.get();
+    return sweep.results();
+}
+
+bool writeSweepCsv(const std::string& path, const std::vector<SweepResult>& results,
+                   std::string* error)
+{
+    std::vector<const SweepResult*> sorted;
+    for (const SweepResult& r : results) sorted.push_back(&r);
+    std::stable_sort(sorted.begin(), sorted.end(), [](auto* a, auto* b) {
+        return a->bestBenchmark > b->bestBenchmark;
+    });
+
+    std::ostringstream os;
+    os << "population,eliteRate,mutationRate,games,maxMoves,status,generations,"
+          "bestBenchmark,finalBenchmark,bestFitness,gamesPlayed,cpuSeconds";
+    for (int i = 0; i < GeneCount; ++i) os << ',' << Genes[i].name;
+    os << '\n';
+    for (const SweepResult* r : sorted) {
+        const SweepConfig& c = r->config;
+        os << c.populationSize << ',' << c.eliteRate << ',' << c.mutationRate << ','
+           << c.games << ',' << c.maxMoves << ',' << sweepStatusName(r->status) << ','
+           << r->generations << ',' << r->bestBenchmark << ',' << r->finalBenchmark << ','
+           << r->bestFitness << ',' << r->gamesPlayed << ',' << r->cpuSeconds;
+        for (int i = 0; i < GeneCount; ++i) os << ',' << r->bestWeights[i];
+        os << '\n';
+    }
+    return writeFileAtomically(path, os.str(), error);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "ai2048.h"
+#include "halloffame2048.h"
+
+// Hyperparameter sweeps: many GA runs, each with its own settings, trained
+// side by side on one pool of threads.
+//
+// The pool's unit of work is one individual's fitness games or one
+// benchmark game of a run's champion. Idle threads always serve the run
+// that has used the least CPU time so far, so short and long settings
+// advance together. Mean fitness is not comparable across settings (games
+// and maxMoves change what it measures), so every generation's champion
+// also plays a small fixed-seed benchmark; runs are compared, and stopped,
+// on that.
+
+struct SweepConfig {
+    int    populationSize = 40;
+    double eliteRate      = 0.1;
+    double mutationRate   = 0.1;
+    int    games          = 10;
+    int    maxMoves       = 1000;
+};
+
+// A grid, "population=20,40;elite=0.1;mutation=0.05,0.1,0.2;games=5,10;
+// maxMoves=1000", expands to every combination; omitted keys keep the
+// SweepConfig default. "random:<n>" draws n configurations instead.
+bool parseSweepSpec(const std::string& spec, std::vector<SweepConfig>& out,
+                    std::string* error = nullptr);
+
+struct SweepOptions {
+    int generations = 20;
+    int threadCount = 0;   // 0 = all cores
+
+    // Champion benchmark played after every generation.
+    BenchmarkSpec benchmark = {BenchmarkSpec().seedBase, 20, 5000};
+
+    // A run stops once it has done minGenerations and its best benchmark
+    // mean is below behindFraction of the best any run had after as many
+    // generations, or once it has not improved for `patience` generations.
+    int    minGenerations = 3;
+    double behindFraction = 0.8;
+    int    patience       = 6;
+};
+
+struct SweepResult {
+    enum class Status { Finished, Behind, Stalled };
+
+    SweepConfig config;
+    Status      status       = Status::Finished;
+    int         generations  = 0;
+    double      bestBenchmark  = 0.0;   // best champion benchmark mean
+    double      finalBenchmark = 0.0;   // last champion benchmark mean
+    double      bestFitness  = 0.0;
+    Weights     bestWeights;            // the best benchmarked champion
+    long long   gamesPlayed  = 0;       // benchmark games included
+    double      cpuSeconds   = 0.0;
+};
+
+const char* sweepStatusName(SweepResult::Status status);
+
+// Results come back in config order. onRunEnd, if set, is called (from a
+// pool thread, one call at a time) as each run finishes or is stopped.
+std::vector<SweepResult> runSweep(const std::vector<SweepConfig>& configs,
+                                  const SweepOptions& options,
+                                  const std::function<void(const SweepResult&)>& onRunEnd = {});
+
+// One row per run, best benchmark first.
+bool writeSweepCsv(const std::string& path, const std::vector<SweepResult>& results,
+                   std::string* error = nullptr);
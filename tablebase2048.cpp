@@ -0,0 +1,387 @@
+#include "tablebase2048.h"
+#include "game2048.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TABLEBASE_MMAP 1
+#endif
+
+namespace {
+
+const char kMagic[8] = {'2', '0', '4', '8', 'T', 'B', '\0', '\2'};
+
+// Followed by the canonical-position bitmap (one bit per index, in 64-bit
+// words), the rank of each block of kBlockWords words, and one 16-bit value
+// per canonical position.
+struct FileHeader {
+    char          magic[8];
+    std::uint32_t size;
+    std::uint32_t goalExponent;
+    std::uint64_t entries;     // goalExponent ^ cells indices
+    std::uint64_t canonical;   // stored values
+};
+static_assert(sizeof(FileHeader) == 32, "tablebase header must stay packed");
+
+constexpr double kScale = 65535.0;
+constexpr std::uint64_t kBlockWords = 8;
+
+int popcount64(std::uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(x);
+#else
+    int n = 0;
+    for (; x; x &= x - 1) ++n;
+    return n;
+#endif
+}
+
+std::vector<std::uint64_t> digitPowers(int cells, int k) {
+    std::vector<std::uint64_t> pow(cells + 1, 1);
+    for (int i = 1; i <= cells; ++i) pow[i] = pow[i - 1] * std::uint64_t(k);
+    return pow;
+}
+
+std::uint64_t bitmapWords(std::uint64_t entries) { return (entries + 63) / 64; }
+std::uint64_t rankBlocks(std::uint64_t entries) {
+    return (bitmapWords(entries) + kBlockWords - 1) / kBlockWords;
+}
+
+// Cells of a packed board read as base-k digits; every exponent must be
+// below k.
+std::uint64_t indexOf(Board64 b, const std::vector<std::uint64_t>& pow, int cells) {
+    std::uint64_t index = 0;
+    for (int i = 0; i < cells; ++i) index += ((b >> (4 * i)) & 0xF) * pow[i];
+    return index;
+}
+
+// Slot of a canonical index among the stored values.
+std::uint64_t rankOf(const std::uint64_t* bits, const std::uint32_t* ranks, std::uint64_t index) {
+    const std::uint64_t word = index / 64;
+    std::uint64_t rank = ranks[word / kBlockWords];
+    for (std::uint64_t w = word - word % kBlockWords; w < word; ++w) rank += popcount64(bits[w]);
+    return rank + popcount64(bits[word] & ((std::uint64_t(1) << (index % 64)) - 1));
+}
+
+// Slides cells[idx[0..n)] towards idx[0]. Returns whether anything moved;
+// sets won when a merge reaches exponent k.
+bool slideLine(int* cells, const int* idx, int n, int k, bool& won) {
+    int out[8] = {};
+    int count = 0;
+    int last = 0;
+    bool changed = false;
+
+    for (int j = 0; j < n; ++j) {
+        int v = cells[idx[j]];
+        if (v == 0) continue;
+        if (last != 0 && last == v) {
+            out[count - 1] = v + 1;
+            if (v + 1 >= k) won = true;
+            last = 0;
+        } else {
+            out[count++] = v;
+            last = v;
+        }
+    }
+    for (int j = 0; j < n; ++j) {
+        int v = (j < count) ? out[j] : 0;
+        if (cells[idx[j]] != v) changed = true;
+        cells[idx[j]] = v;
+    }
+    return changed;
+}
+
+// Direction order matches the Direction enum: left, right, up, down.
+bool applyMove(int* cells, int n, int dir, int k, bool& won) {
+    bool changed = false;
+    int idx[8];
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            int p = (dir == 1 || dir == 3) ? n - 1 - j : j;
+            idx[j] = (dir < 2) ? i * n + p : p * n + i;
+        }
+        changed |= slideLine(cells, idx, n, k, won);
+    }
+    return changed;
+}
+
+} // namespace
+
+bool buildTablebase(int size, int goalExponent, const std::string& path, std::string* error)
+{
+    const int n = size;
+    const int k = goalExponent;
+    const int cells = n * n;
+    if (n < 2 || n > 4 || k < 2 || k > 15) {
+        if (error) *error = "size must be 2-4 and goal exponent 2-15";
+        return false;
+    }
+
+    const std::vector<std::uint64_t> pow = digitPowers(cells, k);
+    const std::uint64_t entries = pow[cells];
+    if (entries > 0xffffffffULL) {
+        if (error) *error = "table too large";
+        return false;
+    }
+
+    // Every board's value is shared by its symmetric forms, so only the
+    // canonical one (canonicalBoard()) is solved and stored.
+    auto boardOf = [&](std::uint64_t index) {
+        Board64 b = 0;
+        for (int i = 0; i < cells; ++i, index /= k) b |= Board64(index % k) << (4 * i);
+        return b;
+    };
+    std::vector<std::uint64_t> bits(bitmapWords(entries), 0);
+    std::vector<std::uint32_t> ranks(rankBlocks(entries), 0);
+    std::uint64_t canonical = 0;
+    for (std::uint64_t i = 0; i < entries; ++i) {
+        if (i % (64 * kBlockWords) == 0) ranks[i / (64 * kBlockWords)] = std::uint32_t(canonical);
+        const Board64 b = boardOf(i);
+        if (canonicalBoard(b, n) != b) continue;
+        bits[i / 64] |= std::uint64_t(1) << (i % 64);
+        ++canonical;
+    }
+
+    // Tile sums in units of 2; spawns add 1 or 2 of these.
+    auto halfSum = [&](std::uint64_t index) {
+        std::uint32_t s = 0;
+        for (int i = 0; i < cells; ++i, index /= k) {
+            int e = int(index % k);
+            if (e > 0) s += 1u << (e - 1);
+        }
+        return s;
+    };
+    auto isCanonical = [&](std::uint64_t index) { return (bits[index / 64] >> (index % 64)) & 1; };
+    const std::uint32_t maxSum = std::uint32_t(cells) << (k - 2);
+
+    // Counting sort of canonical positions by descending tile sum.
+    std::vector<std::uint32_t> start(maxSum + 2, 0);
+    for (std::uint64_t i = 0; i < entries; ++i)
+        if (isCanonical(i)) ++start[maxSum - halfSum(i) + 1];
+    for (std::uint32_t s = 1; s < start.size(); ++s) start[s] += start[s - 1];
+    std::vector<std::uint32_t> order(canonical);
+    for (std::uint64_t i = 0; i < entries; ++i)
+        if (isCanonical(i)) order[start[maxSum - halfSum(i)]++] = std::uint32_t(i);
+    start.clear();
+    start.shrink_to_fit();
+
+    std::vector<float> value(canonical, 0.0f);
+    auto lookup = [&](Board64 after, int cell, int e) -> double {
+        if (e >= k) return 1.0;
+        const Board64 b = canonicalBoard(after | (Board64(e) << (4 * cell)), n);
+        return value[rankOf(bits.data(), ranks.data(), indexOf(b, pow, cells))];
+    };
+
+    int board[16];
+    int after[16];
+    for (std::uint64_t pos = 0; pos < canonical; ++pos) {
+        const std::uint32_t index = order[pos];
+        std::uint64_t rest = index;
+        for (int i = 0; i < cells; ++i, rest /= k) board[i] = int(rest % k);
+
+        double best = 0.0;
+        for (int dir = 0; dir < 4 && best < 1.0; ++dir) {
+            std::copy(board, board + cells, after);
+            bool won = false;
+            if (!applyMove(after, n, dir, k, won)) continue;
+            if (won) {
+                best = 1.0;
+                break;
+            }
+
+            Board64 afterBoard = 0;
+            for (int i = 0; i < cells; ++i) afterBoard |= Board64(after[i]) << (4 * i);
+
+            // A legal move always leaves at least one empty cell.
+            double total = 0.0;
+            int empties = 0;
+            for (int i = 0; i < cells; ++i) {
+                if (after[i] != 0) continue;
+                ++empties;
+                total += 0.9 * lookup(afterBoard, i, 1) + 0.1 * lookup(afterBoard, i, 2);
+            }
+            best = std::max(best, total / empties);
+        }
+        value[rankOf(bits.data(), ranks.data(), index)] = float(best);
+    }
+    order.clear();
+    order.shrink_to_fit();
+
+    std::ofstream ofs(path, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) {
+        if (error) *error = "cannot write " + path;
+        return false;
+    }
+
+    FileHeader h;
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.size = std::uint32_t(n);
+    h.goalExponent = std::uint32_t(k);
+    h.entries = entries;
+    h.canonical = canonical;
+    ofs.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    ofs.write(reinterpret_cast<const char*>(bits.data()),
+              std::streamsize(bits.size() * sizeof(std::uint64_t)));
+    ofs.write(reinterpret_cast<const char*>(ranks.data()),
+              std::streamsize(ranks.size() * sizeof(std::uint32_t)));
+
+    std::vector<std::uint16_t> chunk;
+    chunk.reserve(1 << 16);
+    for (std::uint64_t i = 0; i < canonical; ++i) {
+        chunk.push_back(std::uint16_t(value[i] * kScale + 0.5));
+        if (chunk.size() == chunk.capacity() || i + 1 == canonical) {
+            ofs.write(reinterpret_cast<const char*>(chunk.data()),
+                      std::streamsize(chunk.size() * sizeof(std::uint16_t)));
+            chunk.clear();
+        }
+    }
+    return static_cast<bool>(ofs);
+}
+
+Tablebase::~Tablebase() {
+    close();
+}
+
+void Tablebase::close() {
+#ifdef TABLEBASE_MMAP
+    if (m_map) ::munmap(m_map, m_mapSize);
+#endif
+    m_map = nullptr;
+    m_mapSize = 0;
+    m_bits = nullptr;
+    m_ranks = nullptr;
+    m_values = nullptr;
+    m_fallback.clear();
+    m_n = m_k = 0;
+}
+
+bool Tablebase::open(const std::string& path, std::string* error) {
+    close();
+
+    FileHeader h;
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs.read(reinterpret_cast<char*>(&h), sizeof(h))
+            || std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0
+            || h.size < 2 || h.size > 4 || h.goalExponent < 2 || h.goalExponent > 15) {
+            if (error) *error = path + " is not a tablebase";
+            return false;
+        }
+    }
+
+    const int cells = int(h.size * h.size);
+    std::vector<std::uint64_t> pow = digitPowers(cells, int(h.goalExponent));
+    if (pow[cells] != h.entries || h.canonical > h.entries) {
+        if (error) *error = path + " has an inconsistent header";
+        return false;
+    }
+    const std::size_t bitsBytes  = bitmapWords(h.entries) * sizeof(std::uint64_t);
+    const std::size_t ranksBytes = rankBlocks(h.entries) * sizeof(std::uint32_t);
+    const std::size_t body  = bitsBytes + ranksBytes + h.canonical * sizeof(std::uint16_t);
+    const std::size_t bytes = sizeof(h) + body;
+
+#ifdef TABLEBASE_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0 || std::size_t(st.st_size) < bytes) {
+        if (fd >= 0) ::close(fd);
+        if (error) *error = path + " is truncated";
+        return false;
+    }
+    void* map = ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        if (error) *error = "cannot map " + path;
+        return false;
+    }
+    m_map = map;
+    m_mapSize = bytes;
+    const char* data = static_cast<const char*>(map) + sizeof(h);
+#else
+    std::ifstream ifs(path, std::ios::binary);
+    ifs.seekg(sizeof(h));
+    m_fallback.resize((body + 7) / 8);
+    if (!ifs.read(reinterpret_cast<char*>(m_fallback.data()), std::streamsize(body))) {
+        m_fallback.clear();
+        if (error) *error = path + " is truncated";
+        return false;
+    }
+    const char* data = reinterpret_cast<const char*>(m_fallback.data());
+#endif
+
+    m_bits   = reinterpret_cast<const std::uint64_t*>(data);
+    m_ranks  = reinterpret_cast<const std::uint32_t*>(data + bitsBytes);
+    m_values = reinterpret_cast<const std::uint16_t*>(data + bitsBytes + ranksBytes);
+    m_n = int(h.size);
+    m_k = int(h.goalExponent);
+    m_pow = std::move(pow);
+    return true;
+}
+
+bool Tablebase::covers(const Game2048& game) const {
+    Board64 b;
+    return isOpen() && game.size() == m_n && game.maxTile() < (1 << m_k)
+        && packBoard(game, b);
+}
+
+double Tablebase::value(Board64 b) const {
+    const int cells = m_n * m_n;
+    for (int i = 0; i < cells; ++i)
+        if (int((b >> (4 * i)) & 0xF) >= m_k) return 1.0;
+    const std::uint64_t index = indexOf(canonicalBoard(b, m_n), m_pow, cells);
+    return m_values[rankOf(m_bits, m_ranks, index)] / kScale;
+}
+
+bool Tablebase::bestMove(const Game2048& game, Direction& outDir, double* outValue) const {
+    if (!covers(game)) return false;
+
+    const Direction dirs[] = { Direction::Left, Direction::Right, Direction::Up, Direction::Down };
+    const int cells = m_n * m_n;
+
+    double best = -1.0;
+    for (Direction d : dirs) {
+        Game2048 tmp = game;
+        tmp.setAutoSpawn(false);
+        bool moved = false;
+        switch (d) {
+        case Direction::Left:  moved = tmp.moveLeft();  break;
+        case Direction::Right: moved = tmp.moveRight(); break;
+        case Direction::Up:    moved = tmp.moveUp();    break;
+        case Direction::Down:  moved = tmp.moveDown();  break;
+        }
+        if (!moved) continue;
+
+        Board64 after;
+        if (!packBoard(tmp, after)) continue;
+
+        double v = 0.0;
+        if (tmp.maxTile() >= (1 << m_k)) {
+            v = 1.0;
+        } else {
+            int empties = 0;
+            for (int i = 0; i < cells; ++i) {
+                if ((after >> (4 * i)) & 0xF) continue;
+                ++empties;
+                v += 0.9 * value(after | (Board64(1) << (4 * i)))
+                   + 0.1 * value(after | (Board64(2) << (4 * i)));
+            }
+            v /= empties;
+        }
+
+        if (v > best) {
+            best = v;
+            outDir = d;
+        }
+    }
+
+    if (best < 0.0) return false;
+    if (outValue) *outValue = best;
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ai2048.h"
+#include "bitboard2048.h"
+
+// Exact probability of reaching a goal tile under optimal play, for every
+// board of a given size whose tiles are all below the goal.
+//
+// The table is built offline by retrograde analysis: a turn always raises
+// the tile sum by 2 or 4, so processing positions from the largest sum down
+// means every successor is already solved when a position is reached.
+// A value is the same for all eight symmetric forms of a board, so only
+// canonical boards (canonicalBoard()) are stored, as 16-bit fixed point. A
+// bitmap over the base-goalExponent reading of the cells marks them and
+// per-block counts rank them into the values, which takes the 3x3 table to
+// 128 from 80 MB to 16 MB.
+//
+// This is a prototype for small-board experiments. The game is played on
+// 4x4, where a dense index stops at goal 8, so no shipped player opens a
+// table; SearchOptions::tablebase is there for callers that do.
+bool buildTablebase(int size, int goalExponent, const std::string& path,
+                    std::string* error = nullptr);
+
+class Tablebase {
+public:
+    Tablebase() = default;
+    ~Tablebase();
+
+    Tablebase(const Tablebase&) = delete;
+    Tablebase& operator=(const Tablebase&) = delete;
+
+    // Maps the file read-only; lookups then touch a single entry.
+    bool open(const std::string& path, std::string* error = nullptr);
+    void close();
+
+    bool isOpen()       const { return m_values != nullptr; }
+    int  size()         const { return m_n; }
+    int  goalExponent() const { return m_k; }
+
+    // True if the board has this table's size and is still short of the
+    // goal tile. Past the goal every move is worth 1, so the table can no
+    // longer tell them apart and play must fall back to search.
+    bool covers(const Game2048& game) const;
+    double value(Board64 b) const;
+
+    // Move with the highest probability of reaching the goal. False when
+    // the board is not covered or has no legal move.
+    bool bestMove(const Game2048& game, Direction& outDir, double* outValue = nullptr) const;
+
+private:
+    int m_n = 0;
+    int m_k = 0;
+    std::vector<std::uint64_t> m_pow;
+
+    const std::uint64_t* m_bits   = nullptr;   // canonical indices
+    const std::uint32_t* m_ranks  = nullptr;   // canonical indices before each block
+    const std::uint16_t* m_values = nullptr;
+    void*       m_map = nullptr;
+    std::size_t m_mapSize = 0;
+    std::vector<std::uint64_t> m_fallback;   // used where mmap is unavailable
+};
@@ -0,0 +1,230 @@
+#include "trace2048.h"
+
+#include <cstdio>
+
+#ifdef AI2048_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct Event {
+    const char*   name;
+    std::uint64_t startNs;
+    std::uint64_t durationNs;
+};
+
+// Written only by its thread. Chunks are published before the count that
+// covers them, so a reader that loads the count sees every chunk it needs.
+class ThreadBuffer {
+public:
+    static constexpr std::size_t ChunkEvents = 1 << 14;
+    static constexpr std::size_t MaxChunks   = 64;   // ~1M events per thread
+
+    ThreadBuffer(int tid) : m_tid(tid) {}
+
+    ~ThreadBuffer() {
+        for (auto& c : m_chunks) delete c.load();
+    }
+
+    void push(const Event& e) {
+        const std::size_t i = m_count.load(std::memory_order_relaxed);
+        const std::size_t chunk = i / ChunkEvents;
+        if (chunk >= MaxChunks) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Chunk* c = m_chunks[chunk].load(std::memory_order_relaxed);
+        if (!c) {
+            c = new Chunk;
+            m_chunks[chunk].store(c, std::memory_order_release);
+        }
+        c->events[i % ChunkEvents] = e;
+        m_count.store(i + 1, std::memory_order_release);
+    }
+
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        const std::size_t n = m_count.load(std::memory_order_acquire);
+        for (std::size_t i = 0; i < n; ++i)
+            fn(m_chunks[i / ChunkEvents].load(std::memory_order_acquire)->events[i % ChunkEvents]);
+    }
+
+    int tid() const { return m_tid; }
+    long long dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    std::atomic<const char*> name{nullptr};
+
+private:
+    struct Chunk {
+        Event events[ChunkEvents];
+    };
+
+    const int m_tid;
+    std::atomic<std::size_t> m_count{0};
+    std::atomic<long long> m_dropped{0};
+    std::atomic<Chunk*> m_chunks[MaxChunks] = {};
+};
+
+struct Registry {
+    std::mutex mutex;
+    // Buffers outlive their threads so short-lived task threads still show
+    // up; those of exited threads wait in `idle` for the next new thread.
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::vector<ThreadBuffer*> idle;
+    std::atomic<bool> enabled{false};
+    const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+// Hands the thread's buffer back when the thread exits. Search and fitness
+// spawn a thread per task, so without reuse every one of them would keep a
+// chunk of its own for the rest of the run.
+struct BufferLease {
+    ThreadBuffer* buffer = nullptr;
+
+    ~BufferLease() {
+        if (!buffer) return;
+        Registry& r = registry();
+        std::scoped_lock lock(r.mutex);
+        r.idle.push_back(buffer);
+    }
+};
+
+ThreadBuffer& threadBuffer() {
+    thread_local BufferLease lease;
+    if (!lease.buffer) {
+        Registry& r = registry();
+        std::scoped_lock lock(r.mutex);
+        if (!r.idle.empty()) {
+            lease.buffer = r.idle.back();
+            r.idle.pop_back();
+        } else {
+            r.buffers.push_back(std::make_unique<ThreadBuffer>(int(r.buffers.size()) + 1));
+            lease.buffer = r.buffers.back().get();
+        }
+    }
+    return *lease.buffer;
+}
+
+std::uint64_t nowNs() {
+    return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - registry().epoch).count());
+}
+
+void writeJsonString(std::FILE* f, const char* s) {
+    std::fputc('"', f);
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') std::fputc('\\', f);
+        if (static_cast<unsigned char>(*s) >= 0x20) std::fputc(*s, f);
+    }
+    std::fputc('"', f);
+}
+
+} // namespace
+
+TraceScope::TraceScope(const char* name)
+    : m_name(registry().enabled.load(std::memory_order_relaxed) ? name : nullptr)
+    , m_startNs(m_name ? nowNs() : 0) {
+}
+
+TraceScope::~TraceScope() {
+    if (m_name) threadBuffer().push({m_name, m_startNs, nowNs() - m_startNs});
+}
+
+void startTracing() {
+    registry().enabled = true;
+}
+
+void stopTracing() {
+    registry().enabled = false;
+}
+
+bool isTracing() {
+    return registry().enabled;
+}
+
+void setTraceThreadName(const char* name) {
+    threadBuffer().name = name;
+}
+
+bool writeTrace(const std::string& path, std::string* error) {
+    std::FILE* f = std::fopen(path.c_str(), "w");
+    if (!f) {
+        if (error) *error = "cannot write " + path;
+        return false;
+    }
+
+    Registry& r = registry();
+    std::scoped_lock lock(r.mutex);
+
+    long long dropped = 0;
+    bool first = true;
+    std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", f);
+    for (const auto& b : r.buffers) {
+        if (!first) std::fputs(",\n", f);
+        first = false;
+        std::fprintf(f, "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", b->tid());
+        const char* name = b->name.load();
+        if (name) {
+            writeJsonString(f, name);
+        } else {
+            std::fprintf(f, "\"thread %d\"", b->tid());
+        }
+        std::fputs("}}", f);
+
+        b->forEach([&](const Event& e) {
+            std::fputs(",\n{\"ph\":\"X\",\"pid\":1,\"tid\":", f);
+            std::fprintf(f, "%d,\"ts\":%.3f,\"dur\":%.3f,\"name\":",
+                         b->tid(), e.startNs / 1000.0, e.durationNs / 1000.0);
+            writeJsonString(f, e.name);
+            std::fputc('}', f);
+        });
+        dropped += b->dropped();
+    }
+    std::fprintf(f, "\n],\"otherData\":{\"droppedEvents\":%lld}}\n", dropped);
+
+    const bool ok = std::fclose(f) == 0;
+    if (!ok && error) *error = "cannot write " + path;
+    return ok;
+}
+
+#else
+
+void startTracing() {}
+void stopTracing() {}
+bool isTracing() { return false; }
+void setTraceThreadName(const char*) {}
+
+bool writeTrace(const std::string&, std::string* error) {
+    if (error) *error = "tracing is not compiled in (build with CONFIG+=trace)";
+    return false;
+}
+
+#endif // AI2048_TRACE
+
+TraceSession::TraceSession(const char* path) {
+#ifdef AI2048_TRACE
+    if (!path) return;
+    m_path = path;
+    setTraceThreadName("main");
+    startTracing();
+#else
+    (void)path;
+#endif
+}
+
+TraceSession::~TraceSession() {
+    if (m_path.empty()) return;
+    stopTracing();
+    std::string error;
+    if (!writeTrace(m_path, &error)) std::fprintf(stderr, "trace: %s\n", error.c_str());
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Scoped trace points, written out as Chrome/Perfetto trace JSON (open the
+// file in ui.perfetto.dev or chrome://tracing).
+//
+// Tracing is compiled in only when AI2048_TRACE is defined (qmake
+// CONFIG+=trace); otherwise TRACE_SCOPE expands to nothing. Each thread
+// appends finished scopes to its own chunked buffer without locking; only
+// a thread's first event takes a lock, to claim a buffer. Buffers of exited
+// threads are handed to new ones, so a trace lane may hold several
+// short-lived threads one after another. Names must be string literals, as
+// only the pointer is stored.
+
+#ifdef AI2048_TRACE
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
+
+void startTracing();
+void stopTracing();
+bool isTracing();
+
+// Names the calling thread in the trace.
+void setTraceThreadName(const char* name);
+
+// Writes every event recorded so far; threads may keep recording meanwhile.
+bool writeTrace(const std::string& path, std::string* error = nullptr);
+
+#ifdef AI2048_TRACE
+class TraceScope {
+public:
+    explicit TraceScope(const char* name);
+    ~TraceScope();
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char*   m_name;
+    std::uint64_t m_startNs;
+};
+#endif
+
+// Traces from construction to destruction and then writes the file; does
+// nothing when path is null or tracing is compiled out.
+class TraceSession {
+public:
+    explicit TraceSession(const char* path);
+    ~TraceSession();
+
+    TraceSession(const TraceSession&) = delete;
+    TraceSession& operator=(const TraceSession&) = delete;
+
+private:
+    std::string m_path;
+};